@@ -0,0 +1,108 @@
+#include "Arena.h"
+#include <stdlib.h>
+#include <algorithm>
+
+// 每个线程最多缓存的标准内存块数量
+static const size_t kMaxCachedChunks = 64;
+
+namespace
+{
+    /**
+     * @brief 线程局部的标准内存块缓存
+     */
+    struct ChunkCache
+    {
+        void *head = nullptr;
+        size_t count = 0;
+
+        ~ChunkCache()
+        {
+            while (head)
+            {
+                void *next = *static_cast<void **>(head);
+                free(head);
+                head = next;
+            }
+        }
+    };
+
+    thread_local ChunkCache t_chunk_cache;
+}
+
+void *Arena::allocateSlow(size_t size, size_t align)
+{
+    size_t need = sizeof(Chunk) + size + align;
+    Chunk *chunk = nullptr;
+    if (need <= kChunkSize && t_chunk_cache.head)
+    {
+        chunk = static_cast<Chunk *>(t_chunk_cache.head);
+        t_chunk_cache.head = *static_cast<void **>(t_chunk_cache.head);
+        --t_chunk_cache.count;
+    }
+    else
+    {
+        size_t chunk_size = std::max(need, kChunkSize);
+        chunk = static_cast<Chunk *>(malloc(chunk_size));
+        if (chunk == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+    }
+    chunk->size = std::max(need, kChunkSize);
+    chunk->next = m_head;
+    m_head = chunk;
+    m_ptr = chunk->data();
+    m_end = chunk->end();
+    return allocate(size, align);
+}
+
+void Arena::FreeChunk(Chunk *chunk)
+{
+    if (chunk->size != kChunkSize || t_chunk_cache.count >= kMaxCachedChunks)
+    {
+        free(chunk);
+        return;
+    }
+    *reinterpret_cast<void **>(chunk) = t_chunk_cache.head;
+    t_chunk_cache.head = chunk;
+    ++t_chunk_cache.count;
+}
+
+void Arena::rewind()
+{
+    if (!m_head)
+    {
+        return;
+    }
+    // 只保留链表尾部(最早分配)的一个块
+    while (m_head->next)
+    {
+        Chunk *chunk = m_head;
+        m_head = chunk->next;
+        FreeChunk(chunk);
+    }
+    m_ptr = m_head->data();
+    m_end = m_head->end();
+}
+
+void Arena::release()
+{
+    while (m_head)
+    {
+        Chunk *chunk = m_head;
+        m_head = chunk->next;
+        FreeChunk(chunk);
+    }
+    m_ptr = nullptr;
+    m_end = nullptr;
+}
+
+size_t Arena::chunkCount() const
+{
+    size_t count = 0;
+    for (Chunk *chunk = m_head; chunk; chunk = chunk->next)
+    {
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,127 @@
+#ifndef ARENA_H
+#define ARENA_H
+/**
+ * @brief 协程内存池
+ * @details 顺序分配(bump)的内存池，内存按块链接，单个对象不单独释放，
+ * 在协程结束(TERM)或reset时一次性整体释放，内存块回收到线程局部缓存中复用，
+ * 用于请求处理过程中大量生命周期与协程相同的小对象
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include "../Mutex/noncopyable.h"
+
+class Arena : Noncopyable
+{
+public:
+    // 标准内存块大小(含块头)，这种块会在线程局部缓存中复用
+    static constexpr size_t kChunkSize = 16 * 1024;
+
+    Arena() = default;
+
+    ~Arena()
+    {
+        release();
+    }
+
+    /**
+     * @brief 分配内存
+     * @param[in] size 大小
+     * @param[in] align 对齐，必须是2的幂
+     */
+    void *allocate(size_t size, size_t align = alignof(max_align_t))
+    {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(m_ptr) + align - 1) & ~(uintptr_t)(align - 1);
+        if (m_ptr && p + size <= reinterpret_cast<uintptr_t>(m_end))
+        {
+            m_ptr = reinterpret_cast<char *>(p + size);
+            return reinterpret_cast<void *>(p);
+        }
+        return allocateSlow(size, align);
+    }
+
+    /**
+     * @brief 回退到空的状态，保留第一个内存块，其余块归还缓存
+     */
+    void rewind();
+
+    /**
+     * @brief 释放所有内存块
+     */
+    void release();
+
+    /**
+     * @brief 已经分配出去的内存块数量
+     */
+    size_t chunkCount() const;
+
+private:
+    struct Chunk
+    {
+        // 链表中的下一个块
+        Chunk *next;
+        // 块大小(含块头)
+        size_t size;
+
+        char *data() { return reinterpret_cast<char *>(this + 1); }
+        char *end() { return reinterpret_cast<char *>(this) + size; }
+    };
+
+    /**
+     * @brief 当前块空间不足时申请新块
+     */
+    void *allocateSlow(size_t size, size_t align);
+
+    /**
+     * @brief 归还一个块，标准大小的块放入线程局部缓存
+     */
+    static void FreeChunk(Chunk *chunk);
+
+private:
+    // 当前块，链表头
+    Chunk *m_head = nullptr;
+    // 当前块的分配位置
+    char *m_ptr = nullptr;
+    // 当前块的结束位置
+    char *m_end = nullptr;
+};
+
+/**
+ * @brief 基于Arena的STL分配器，deallocate为空操作，内存随Arena整体释放
+ */
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    /**
+     * @brief 使用当前协程的Arena
+     */
+    ArenaAllocator();
+
+    explicit ArenaAllocator(Arena *arena) : m_arena(arena) {}
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.arena()) {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, size_t) {}
+
+    Arena *arena() const { return m_arena; }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U> &other) const { return m_arena == other.arena(); }
+
+    template <class U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return m_arena != other.arena(); }
+
+private:
+    Arena *m_arena;
+};
+
+#endif
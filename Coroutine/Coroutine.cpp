@@ -1,17 +1,31 @@
 #include "Coroutine.h"
-#include "../Scheduler/Scheduler.h"
+#include "../Scheduler/SchedulerBase.h"
+#include "../Mutex/ShardedCounter.h"
+#include "../Log/Log.h"
+#include "CoroutineRegistry.h"
+#include "../Trace/Probes.h"
 #include <atomic>
 #include <string.h>
 #include <assert.h>
-#include <iostream>
+#include <errno.h>
+#include <stdexcept>
 
 // 默认栈大小
 #define DEFAULT_STACK_SIZE 1024 * 128
 
-// 全局静态变量，用于生成协程id
-static std::atomic<uint64_t> s_coroutine_id{0};
-// 全局静态变量，用于统计当前协程数量
-static std::atomic<uint64_t> s_coroutine_count{0};
+// 协程id分配器，每个线程按段申请，避免所有线程争抢同一个原子变量
+typedef IdBlockAllocator<Coroutine> CoroutineIdAllocator;
+// 全局静态变量，用于统计当前协程数量，分片计数避免缓存行争抢
+static ShardedCounter s_coroutine_count;
+
+// 协程局部变量下标的上限
+static const size_t kMaxLocalKeys = 1024;
+// 已分配的协程局部变量下标数
+static std::atomic<size_t> s_local_key_count{0};
+// 每个下标对应的析构函数
+static std::atomic<Coroutine::LocalDestructor> s_local_dtors[kMaxLocalKeys];
+// 清理协程局部变量时最多执行析构的轮数
+static const int kLocalDestructorRounds = 4;
 
 // 线程局部变量，当前线程正在运行的协程
 static thread_local Coroutine *thread_coroutine = nullptr;
@@ -24,24 +38,66 @@ static thread_local Coroutine *thread_coroutine = nullptr;
 */
 static thread_local Coroutine::ptr main_coroutine = nullptr;
 
+// 线程局部变量，通过transfer_to/yield_to直接切换过去的协程，由这里持有引用直到它切回调度协程
+static thread_local Coroutine::ptr t_transfer_hold = nullptr;
+// 线程局部变量，切换完成后需要放回调度器任务队列的协程
+static thread_local Coroutine::ptr t_requeue = nullptr;
+// 线程局部变量，t_requeue放回时指定的线程号
+static thread_local int t_requeue_thread = -1;
+// 线程局部变量，切换完成后需要释放的引用
+static thread_local Coroutine::ptr t_release = nullptr;
+// 线程局部变量，切换完成后交给t_suspend_action的协程
+static thread_local Coroutine::ptr t_suspended = nullptr;
+// 线程局部变量，suspend()登记的切换完成后的动作
+static thread_local std::function<void(Coroutine::ptr)> t_suspend_action;
+
+/**
+ * @brief 主动切换期间不允许被信号强制切走
+ * @details reschedule/suspend/switchTo设置好上面这些线程局部变量、还没切换出去的时候，
+ * 如果被时间片信号打断，信号处理函数里的reschedule会覆盖它们，协程丢失或者被放回两次。
+ * 切换回来、切换后的动作执行完之后再恢复原来的设置
+ */
+class SwitchingScope
+{
+public:
+    explicit SwitchingScope(Coroutine *co)
+        : m_coroutine(co), m_prev(co->isPreemptible())
+    {
+        m_coroutine->setPreemptible(false);
+        // 只需要对同一线程上的信号处理函数可见，阻止编译器把后面的写提到前面
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+
+    ~SwitchingScope()
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        m_coroutine->setPreemptible(m_prev);
+    }
+
+private:
+    Coroutine *m_coroutine;
+    bool m_prev;
+};
+
 Coroutine::Coroutine()
 {
     // 设置当前协程为运行协程，因为改构造函数只用来创建第一个协程，所以状态一定为running
     SetThis(this);
-    m_state = RUNNING;
+    setState(RUNNING);
 
     // 成功时返回0
     // 失败了返回-1
     if (getcontext(&m_context))
     {
-        perror("getcontext failed...");
+        YBB_LOG_ERROR("getcontext failed: %s", strerror(errno));
     }
 
     // 当前协程id和协程数量自增
-    ++s_coroutine_count;
-    m_id = s_coroutine_id++;
+    s_coroutine_count.inc();
+    m_id = CoroutineIdAllocator::Next();
+    CoroutineRegistry::Register(this);
 
-    std::cout << "Coroutine() id : " << m_id << std::endl;
+    YBB_LOG_DEBUG("Coroutine() id : %lu", m_id);
 }
 
 /*
@@ -50,16 +106,16 @@ Coroutine::Coroutine()
     @param2 stacksize 栈大小默认128k
     */
 Coroutine::Coroutine(std::function<void()> func, size_t stacksize, bool run_in_scheduler)
-    : m_id(s_coroutine_id++), m_func(func), m_runInScheduler(run_in_scheduler)
+    : m_id(CoroutineIdAllocator::Next()), m_func(func), m_runInScheduler(run_in_scheduler)
 {
-    ++s_coroutine_count;
+    s_coroutine_count.inc();
 
     // 分配协程栈空间
     m_stacksize = stacksize ? stacksize : DEFAULT_STACK_SIZE;
     m_stack = malloc(m_stacksize);
     if (m_stack == nullptr)
     {
-        perror("malloc stack failed...");
+        YBB_LOG_ERROR("malloc stack failed: %s", strerror(errno));
     }
     // m_stack = new char[m_stacksize];
     memset(m_stack, 0, m_stacksize);
@@ -67,7 +123,7 @@ Coroutine::Coroutine(std::function<void()> func, size_t stacksize, bool run_in_s
     // 获取上下文
     if (getcontext(&m_context))
     {
-        perror("getcontext failed...");
+        YBB_LOG_ERROR("getcontext failed: %s", strerror(errno));
     }
     // 设置上下文
     m_context.uc_stack.ss_sp = m_stack;
@@ -76,14 +132,22 @@ Coroutine::Coroutine(std::function<void()> func, size_t stacksize, bool run_in_s
 
     makecontext(&m_context, &Coroutine::MainFunc, 0);
 
-    std::cout << "Coroutine() id : " << m_id << std::endl;
+    m_stateSinceUS = ybb::GetCoarseUS();
+    CoroutineRegistry::Register(this);
+    YBB_PROBE2(coroutine__create, m_id, m_stacksize);
+
+    YBB_LOG_DEBUG("Coroutine() id : %lu", m_id);
 }
 /*
 @brief 析构函数
 */
 Coroutine::~Coroutine()
 {
-    --s_coroutine_count;
+    s_coroutine_count.dec();
+    // 先从注册表摘除，之后诊断线程就不会再访问这个协程和它的栈
+    CoroutineRegistry::Unregister(this);
+    // 没有运行过的协程和主协程也可能设置过局部变量
+    clearLocals();
     // 主协程由无参构造函数创建，没有对应的栈
     if (m_stack)
     {
@@ -100,7 +164,7 @@ Coroutine::~Coroutine()
             SetThis(nullptr);
         }
     }
-    std::cout << "~Coroutine() id : " << m_id << std::endl;
+    YBB_LOG_DEBUG("~Coroutine() id : %lu", m_id);
 }
 
 /*
@@ -143,22 +207,28 @@ void Coroutine::resume()
     assert(m_state != TERM && m_state != RUNNING);
     // 设置当前协程为this
     SetThis(this);
-    m_state = RUNNING;
+    setState(RUNNING);
+    m_waitReason = nullptr;
+    YBB_PROBE2(coroutine__resume, m_id, m_runInScheduler);
     if (m_runInScheduler)
     {
+        m_scheduler = SchedulerBase::GetThis();
         //如果协程参与调度器调度，那么和调度器协程swap
-        if (swapcontext(&(Scheduler::GetMainCoroutine()->m_context), &m_context))
+        if (swapcontext(&(SchedulerBase::GetMainCoroutine()->m_context), &m_context))
         {
-            perror("resume swapcontext failed...");
+            YBB_LOG_ERROR("resume swapcontext failed: %s", strerror(errno));
         }
     }
     else
     {
         if (swapcontext(&main_coroutine->m_context, &m_context))
         {
-            perror("resume swapcontext failed...");
+            YBB_LOG_ERROR("resume swapcontext failed: %s", strerror(errno));
         }
     }
+    // 回到主协程，中途直接切换过去的协程已经让出，可以释放
+    AfterSwitch();
+    t_transfer_hold.reset();
     // 由于实现的是非对称协程，所有协程只能由主协程进行调控，所以这里保存的上下文是main_coroutine的上下文
 }
 
@@ -171,28 +241,128 @@ void Coroutine::yield()
 {
     // 运行完成后会自动yield此时为term状态
     assert(m_state == RUNNING || m_state == TERM);
-    // 回到主协程
-    SetThis(main_coroutine.get());
+    SwitchingScope switching(this);
+    // 参与调度的协程回到当前线程的调度协程，否则回到主协程；
+    // 两者只在use_caller的线程上不同，协程迁移到别的调度器后也要以所在线程为准
+    SetThis(m_runInScheduler ? SchedulerBase::GetMainCoroutine() : main_coroutine.get());
     if (m_state != TERM)
     {
-        m_state = READY;
+        setState(READY);
     }
+    YBB_PROBE2(coroutine__yield, m_id, m_state);
     //上下文切换
     if (m_runInScheduler)
     {
         //如果协程参与调度器调度，那么和调度器协程swap
-        if (swapcontext(&m_context,&(Scheduler::GetMainCoroutine()->m_context)))
+        if (swapcontext(&m_context,&(SchedulerBase::GetMainCoroutine()->m_context)))
         {
-            perror("resume swapcontext failed...");
+            YBB_LOG_ERROR("resume swapcontext failed: %s", strerror(errno));
         }
     }
     else
     {
         if (swapcontext(&m_context, &main_coroutine->m_context))
         {
-            perror("resume swapcontext failed...");
+            YBB_LOG_ERROR("resume swapcontext failed: %s", strerror(errno));
         }
     }
+    AfterSwitch();
+}
+
+void Coroutine::transfer_to(Coroutine::ptr other)
+{
+    switchTo(std::move(other), false);
+}
+
+void Coroutine::yield_to(Coroutine::ptr other)
+{
+    // 只有参与调度的协程才能被放回任务队列
+    assert(m_runInScheduler && SchedulerBase::GetThis());
+    switchTo(std::move(other), true);
+}
+
+/*
+    @brief 直接切换到目标协程，只发生一次上下文切换
+    @details 调度协程的resume()仍然在等待，目标协程之后yield时回到的还是同一个调度协程，
+    所以调度器的活跃线程数等状态不受影响
+    */
+void Coroutine::switchTo(Coroutine::ptr other, bool requeue)
+{
+    assert(thread_coroutine == this);
+    assert(m_state == RUNNING);
+    assert(other && other.get() != this);
+    assert(other->m_state == READY);
+    assert(other->m_runInScheduler == m_runInScheduler);
+
+    SwitchingScope switching(this);
+    setState(READY);
+    if (requeue)
+    {
+        t_requeue = shared_from_this();
+    }
+    else if (!m_waitReason)
+    {
+        m_waitReason = "transfer";
+    }
+    // 如果当前协程本身也是被直接切换过来的，切换完成后再释放对它的持有
+    t_release = std::move(t_transfer_hold);
+    t_transfer_hold = other;
+
+    other->setState(RUNNING);
+    other->m_waitReason = nullptr;
+    other->m_scheduler = m_scheduler;
+    SetThis(other.get());
+    Coroutine *target = other.get();
+    other.reset();
+    if (swapcontext(&m_context, &target->m_context))
+    {
+        YBB_LOG_ERROR("transfer swapcontext failed: %s", strerror(errno));
+    }
+    AfterSwitch();
+}
+
+void Coroutine::reschedule(int thread)
+{
+    assert(thread_coroutine == this);
+    assert(m_runInScheduler && SchedulerBase::GetThis());
+    SwitchingScope switching(this);
+    t_requeue = shared_from_this();
+    t_requeue_thread = thread;
+    yield();
+}
+
+void Coroutine::suspend(std::function<void(Coroutine::ptr)> on_suspended)
+{
+    assert(thread_coroutine == this);
+    assert(m_runInScheduler && SchedulerBase::GetThis());
+    SwitchingScope switching(this);
+    t_suspended = shared_from_this();
+    t_suspend_action = std::move(on_suspended);
+    yield();
+}
+
+void Coroutine::AfterSwitch()
+{
+    if (t_release)
+    {
+        t_release.reset();
+    }
+    if (t_suspended)
+    {
+        Coroutine::ptr co;
+        co.swap(t_suspended);
+        std::function<void(Coroutine::ptr)> action;
+        action.swap(t_suspend_action);
+        action(std::move(co));
+    }
+    if (t_requeue)
+    {
+        Coroutine::ptr co;
+        co.swap(t_requeue);
+        int thread = t_requeue_thread;
+        t_requeue_thread = -1;
+        SchedulerBase::GetThis()->scheduleCoroutine(co, thread);
+    }
 }
 
 /*
@@ -200,12 +370,19 @@ void Coroutine::yield()
     */
 void Coroutine::MainFunc()
 {
+    // 可能是被transfer_to/yield_to直接切换过来的，先处理上一个协程遗留的动作
+    AfterSwitch();
     Coroutine::ptr cur = GetThis();
     assert(cur);
 
     cur->m_func(); // 这里进行协程的执行，真正的入口函数
     cur->m_func = nullptr;
-    cur->m_state = TERM;
+    // 仍在协程自己的上下文中析构局部变量，析构函数里还可以访问其他协程局部变量
+    cur->clearLocals();
+    // 局部变量可能引用内存池中的对象，最后释放内存池
+    cur->m_arena.release();
+    cur->setState(TERM);
+    YBB_PROBE1(coroutine__term, cur->m_id);
     // 这里的解释
     /*
     这里为什么要使用裸指针调用yield()而不是使用cur来调用呢？
@@ -229,10 +406,12 @@ void Coroutine::reset(std::function<void()> func)
     // 主协程是没有栈的，只复用子协程
     assert(m_stack);
     assert(m_state == TERM);
+    clearLocals();
+    m_arena.release();
     m_func = func;
     if (getcontext(&m_context))
     {
-        perror("reset getcontext failed...");
+        YBB_LOG_ERROR("reset getcontext failed: %s", strerror(errno));
     }
     m_context.uc_link = nullptr;
     m_context.uc_stack.ss_sp = m_stack;
@@ -240,13 +419,90 @@ void Coroutine::reset(std::function<void()> func)
 
     makecontext(&m_context, &Coroutine::MainFunc, 0);
 
-    m_state = READY;
+    setState(READY);
+    m_waitReason = nullptr;
+    m_label = nullptr;
+    m_preemptible = false;
+}
+
+void Coroutine::setState(State state)
+{
+    m_state = state;
+    m_stateSinceUS = ybb::GetCoarseUS();
+}
+
+Arena *Coroutine::GetArena()
+{
+    Coroutine *cur = thread_coroutine;
+    return cur ? &cur->m_arena : &GetThis()->m_arena;
+}
+
+Coroutine *Coroutine::GetCurrent()
+{
+    return thread_coroutine;
+}
+
+size_t Coroutine::AllocLocalKey(LocalDestructor dtor)
+{
+    size_t index = s_local_key_count++;
+    if (index >= kMaxLocalKeys)
+    {
+        throw std::logic_error("too many coroutine local keys");
+    }
+    s_local_dtors[index].store(dtor, std::memory_order_release);
+    return index;
+}
+
+void Coroutine::setLocal(size_t index, void *value)
+{
+    if (index < kInlineLocalSlots)
+    {
+        m_locals[index] = value;
+        return;
+    }
+    index -= kInlineLocalSlots;
+    if (!m_overflowLocals)
+    {
+        m_overflowLocals.reset(new std::vector<void *>);
+    }
+    if (index >= m_overflowLocals->size())
+    {
+        m_overflowLocals->resize(index + 1, nullptr);
+    }
+    (*m_overflowLocals)[index] = value;
+}
+
+void Coroutine::clearLocals()
+{
+    // 析构函数中可能再次设置局部变量，最多重复kLocalDestructorRounds轮(同pthread_key)
+    bool found = true;
+    for (int round = 0; found && round < kLocalDestructorRounds; round++)
+    {
+        found = false;
+        size_t count = kInlineLocalSlots + (m_overflowLocals ? m_overflowLocals->size() : 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            void *value = getLocal(i);
+            if (!value)
+            {
+                continue;
+            }
+            found = true;
+            setLocal(i, nullptr);
+            LocalDestructor dtor = s_local_dtors[i].load(std::memory_order_acquire);
+            if (dtor)
+            {
+                dtor(value);
+            }
+        }
+    }
+    m_overflowLocals.reset();
 }
 
 uint64_t Coroutine::TotalCoroutines()
 {
 
-    return s_coroutine_count;
+    return s_coroutine_count.load();
 }
 uint64_t Coroutine::GetCoroutineId()
 {
@@ -2,12 +2,21 @@
 #define COROUTINE_H
 #include <memory>
 #include <functional>
+#include <vector>
 #include <ucontext.h>
+#include "Arena.h"
+
+class SchedulerBase;
+class CoroutineRegistry;
 
 class Coroutine : public std::enable_shared_from_this<Coroutine>
 {
 public:
     typedef std::shared_ptr<Coroutine> ptr;
+    // 协程局部变量的析构函数
+    typedef void (*LocalDestructor)(void *);
+    // 内联在协程对象中的协程局部变量槽数量，超出的部分另外分配
+    static constexpr size_t kInlineLocalSlots = 8;
     /*
     协程状态：running运行中，ready就绪，term结束运行
     */
@@ -63,6 +72,47 @@ public:
     */
     void yield();
 
+    /*
+    @brief 直接切换到另一个就绪协程，不经过调度协程
+    @details 当前协程变为ready，但不会被放回调度器的任务队列，
+    需要由调用者保证之后有人再次调度它(例如挂在某个等待队列上)
+    @param1 other 目标协程，必须是ready状态且与当前协程在同一线程上以同样的方式调度
+    */
+    void transfer_to(Coroutine::ptr other);
+
+    /*
+    @brief 把执行权直接让给另一个就绪协程
+    @details 与transfer_to相同，但当前协程在切换完成后会被放回当前调度器的任务队列
+    @param1 other 目标协程
+    */
+    void yield_to(Coroutine::ptr other);
+
+    /*
+    @brief 把当前协程放回调度器的任务队列并让出执行权
+    @details 放回动作在切换完成后由调度协程执行，不会出现别的线程拿到还没保存好上下文的协程
+    @param1 thread 放回后指定执行的线程号，-1为任意线程
+    */
+    void reschedule(int thread = -1);
+
+    /*
+    @brief 挂起当前协程，切换完成后在调度协程中调用on_suspended(本协程)
+    @details 协程不会被放回任务队列，由on_suspended负责之后把它交给调度器，
+    例如把阻塞调用交给其他线程，完成后再schedule。回调执行时协程的上下文已经保存好，
+    在任何线程上schedule都是安全的
+    @param1 on_suspended 切换完成后的动作
+    */
+    void suspend(std::function<void(Coroutine::ptr)> on_suspended);
+
+    /*
+    @brief 设置是否允许在任意位置被信号强制切换，见PreemptibleScope
+    */
+    void setPreemptible(bool preemptible) { m_preemptible = preemptible; }
+
+    /*
+    @brief 是否允许在任意位置被信号强制切换
+    */
+    bool isPreemptible() const { return m_preemptible; }
+
     /*
     @brief 获取协程id
     */
@@ -73,6 +123,70 @@ public:
     */
     State getState() const { return m_state; };
 
+    /*
+    @brief 设置协程的等待原因，用于诊断，协程再次运行时清空
+    @param1 reason 字符串常量，协程存活期间必须一直有效
+    */
+    void setWaitReason(const char *reason) { m_waitReason = reason; }
+
+    /*
+    @brief 获取协程的等待原因，没有设置时返回nullptr
+    */
+    const char *getWaitReason() const { return m_waitReason; }
+
+    /*
+    @brief 设置任务标签，采样分析器按标签汇总CPU时间，reset时清空
+    @param1 label 字符串常量，协程存活期间必须一直有效
+    */
+    void setLabel(const char *label) { m_label = label; }
+
+    /*
+    @brief 获取任务标签，没有设置时返回nullptr
+    */
+    const char *getLabel() const { return m_label; }
+
+    /*
+    @brief 获取最近一次运行本协程的调度器，没有被调度器运行过时返回nullptr
+    */
+    SchedulerBase *getScheduler() const { return m_scheduler; }
+
+    /*
+    @brief 获取进入当前状态的时间(粗粒度单调时钟，微秒)
+    */
+    uint64_t getStateSince() const { return m_stateSinceUS; }
+
+    /*
+    @brief 读取协程局部变量槽
+    @param1 index 由AllocLocalKey分配的下标
+    */
+    void *getLocal(size_t index) const
+    {
+        if (index < kInlineLocalSlots)
+        {
+            return m_locals[index];
+        }
+        index -= kInlineLocalSlots;
+        return m_overflowLocals && index < m_overflowLocals->size() ? (*m_overflowLocals)[index] : nullptr;
+    }
+
+    /*
+    @brief 设置协程局部变量槽，不会析构原来的值
+    @param1 index 由AllocLocalKey分配的下标
+    @param2 value 新值
+    */
+    void setLocal(size_t index, void *value);
+
+    /*
+    @brief 获取协程的内存池，协程结束或reset时整体释放
+    */
+    Arena &getArena() { return m_arena; }
+
+    /*
+    @brief 获取协程栈的起始地址和大小，主协程没有独立的栈，返回nullptr和0
+    */
+    void *getStack() const { return m_stack; }
+    size_t getStackSize() const { return m_stacksize; }
+
 public:
     /*
     @brief 设置当前正在运行的协程，设置线程局部变量t_coroutine的值
@@ -100,7 +214,50 @@ public:
     @brief 协程⼊⼝函数
     */
     static void MainFunc();
-   
+
+    /*
+    @brief 返回当前线程正在执行的协程的裸指针，没有则返回nullptr
+    @details 不增加引用计数，也不会创建主协程，用于热路径
+    */
+    static Coroutine *GetCurrent();
+
+    /*
+    @brief 全局分配一个协程局部变量下标
+    @param1 dtor 协程结束或reset时对非空值调用的析构函数
+    */
+    static size_t AllocLocalKey(LocalDestructor dtor);
+
+    /*
+    @brief 获取当前协程的内存池
+    */
+    static Arena *GetArena();
+
+private:
+    /*
+    @brief 析构所有协程局部变量，在协程结束、reset和析构时调用
+    */
+    void clearLocals();
+
+    /*
+    @brief 直接切换到目标协程，transfer_to和yield_to的实现
+    @param1 other 目标协程
+    @param2 requeue 切换完成后是否把当前协程放回调度器
+    */
+    void switchTo(Coroutine::ptr other, bool requeue);
+
+    /*
+    @brief 上下文切换完成后，在新上下文中处理上一个协程遗留的动作
+    @details 放回调度队列、释放引用等动作必须在旧协程的上下文保存完毕后才能做，
+    否则别的线程可能拿到一个上下文还没保存好的协程
+    */
+    static void AfterSwitch();
+
+    /*
+    @brief 切换状态并记录进入该状态的时间
+    */
+    void setState(State state);
+
+    friend class CoroutineRegistry;
 
     // 成员变量
 private:
@@ -118,6 +275,32 @@ private:
     std::function<void()> m_func;
     // 协程是否参与调度器调度
     bool m_runInScheduler;
+    // 内联的协程局部变量槽
+    void *m_locals[kInlineLocalSlots] = {nullptr};
+    // 超出内联数量的协程局部变量槽
+    std::unique_ptr<std::vector<void *>> m_overflowLocals;
+    // 协程内存池
+    Arena m_arena;
+    // 最近一次运行本协程的调度器
+    SchedulerBase *m_scheduler = nullptr;
+    // 等待原因，诊断用
+    const char *m_waitReason = nullptr;
+    // 任务标签，采样分析用
+    const char *m_label = nullptr;
+    // 是否允许被信号强制切换
+    volatile bool m_preemptible = false;
+    // 进入当前状态的时间(微秒)
+    uint64_t m_stateSinceUS = 0;
+    // 协程注册表的侵入式链表节点，由CoroutineRegistry维护
+    Coroutine *m_registryPrev = nullptr;
+    Coroutine *m_registryNext = nullptr;
+    void *m_registryShard = nullptr;
 };
 
+template <class T>
+ArenaAllocator<T>::ArenaAllocator()
+    : m_arena(Coroutine::GetArena())
+{
+}
+
 #endif // COROUTINE_H
\ No newline at end of file
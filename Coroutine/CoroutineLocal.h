@@ -0,0 +1,83 @@
+#ifndef COROUTINE_LOCAL_H
+#define COROUTINE_LOCAL_H
+/**
+ * @brief 协程局部变量
+ * @details 协程会在不同的工作线程之间迁移，请求上下文不能放在thread_local里。
+ * 每个CoroutineLocal在构造时分配一个全局下标，值存放在协程对象内部的数组中，
+ * 读写都是O(1)的下标访问；协程结束(TERM)或者reset时自动析构
+ */
+#include "Coroutine.h"
+#include "../Mutex/noncopyable.h"
+
+template <class T>
+class CoroutineLocal : Noncopyable
+{
+public:
+    /**
+     * @brief 构造函数，分配全局下标，通常定义为全局或静态变量
+     */
+    CoroutineLocal()
+        : m_index(Coroutine::AllocLocalKey(&CoroutineLocal::Destroy))
+    {
+    }
+
+    /**
+     * @brief 获取当前协程中的值，没有设置过则返回nullptr
+     */
+    T *get() const
+    {
+        return static_cast<T *>(current()->getLocal(m_index));
+    }
+
+    /**
+     * @brief 设置当前协程中的值，接管value的所有权，原来的值被析构
+     * @param[in] value 新值，由new分配
+     */
+    void set(T *value) const
+    {
+        Coroutine *co = current();
+        T *old = static_cast<T *>(co->getLocal(m_index));
+        co->setLocal(m_index, value);
+        delete old;
+    }
+
+    /**
+     * @brief 获取当前协程中的值，没有设置过则默认构造一个
+     */
+    T &operator*() const
+    {
+        T *value = get();
+        if (!value)
+        {
+            value = new T();
+            current()->setLocal(m_index, value);
+        }
+        return *value;
+    }
+
+    T *operator->() const { return &**this; }
+
+    /**
+     * @brief 析构当前协程中的值
+     */
+    void reset() const { set(nullptr); }
+
+private:
+    static Coroutine *current()
+    {
+        Coroutine *co = Coroutine::GetCurrent();
+        // 线程还没有协程时先初始化主协程，主协程也有自己的局部变量
+        return co ? co : Coroutine::GetThis().get();
+    }
+
+    static void Destroy(void *value)
+    {
+        delete static_cast<T *>(value);
+    }
+
+private:
+    // 全局下标
+    size_t m_index;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "CoroutineRegistry.h"
+#include "StackUnwind.h"
+#include "../Mutex/Mutex.h"
+#include "../Thread/Threads.h"
+#include "../Log/Log.h"
+#include "../util.h"
+#include <errno.h>
+#include <execinfo.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    /**
+     * @brief 一个线程的协程链表
+     */
+    struct alignas(kCacheLineSize) RegistryShard
+    {
+        Spinlock lock;
+        Coroutine *head = nullptr;
+        size_t count = 0;
+    };
+
+    /**
+     * @brief 全局注册表状态，分片只增不减，线程退出后分片留给后面的线程复用
+     */
+    struct RegistryState
+    {
+        Mutex mutex;
+        // 所有分片
+        std::vector<RegistryShard *> shards;
+        // 所属线程已经退出的分片
+        std::vector<RegistryShard *> freeShards;
+        // 线程退出之后创建的协程登记在这里
+        RegistryShard fallback;
+        // 信号触发导出
+        sem_t dumpSem;
+        Thread *dumper = nullptr;
+        int dumpFd = STDERR_FILENO;
+
+        RegistryState()
+        {
+            shards.push_back(&fallback);
+        }
+    };
+
+    RegistryState &GetState()
+    {
+        // 故意不析构，进程退出过程中还会有协程析构
+        static RegistryState *state = new RegistryState;
+        return *state;
+    }
+
+    thread_local RegistryShard *t_shard = nullptr;
+    thread_local bool t_shard_released = false;
+
+    /**
+     * @brief 线程退出时把分片交还给全局
+     */
+    struct ShardGuard
+    {
+        ~ShardGuard()
+        {
+            RegistryState &state = GetState();
+            Mutex::Lock lock(state.mutex);
+            state.freeShards.push_back(t_shard);
+            t_shard = nullptr;
+            t_shard_released = true;
+        }
+    };
+
+    RegistryShard *GetShard()
+    {
+        if (t_shard)
+        {
+            return t_shard;
+        }
+        RegistryState &state = GetState();
+        if (t_shard_released)
+        {
+            return &state.fallback;
+        }
+        {
+            Mutex::Lock lock(state.mutex);
+            if (!state.freeShards.empty())
+            {
+                t_shard = state.freeShards.back();
+                state.freeShards.pop_back();
+            }
+            else
+            {
+                t_shard = new RegistryShard;
+                state.shards.push_back(t_shard);
+            }
+        }
+        static thread_local ShardGuard guard;
+        (void)guard;
+        return t_shard;
+    }
+
+    /**
+     * @brief 栈使用的最高水位
+     * @details 协程栈创建时清零，从低地址往上找第一个被写过的字
+     */
+    size_t StackHighWater(const void *stack, size_t size)
+    {
+        const uint64_t *begin = (const uint64_t *)stack;
+        const uint64_t *end = begin + size / sizeof(uint64_t);
+        const uint64_t *p = begin;
+        while (p < end && *p == 0)
+        {
+            ++p;
+        }
+        return (end - p) * sizeof(uint64_t);
+    }
+
+    /**
+     * @brief 从保存的上下文沿帧指针回溯，只访问协程自己的栈范围
+     */
+    void UnwindContext(const ucontext_t &ctx, const void *stack, size_t size, std::vector<void *> &frames)
+    {
+#if defined(__x86_64__)
+        void *buf[CoroutineRegistry::kMaxBacktrace];
+        size_t depth = ybb::UnwindFramePointers(ctx.uc_mcontext.gregs[REG_RIP], ctx.uc_mcontext.gregs[REG_RBP],
+                                                (uintptr_t)stack, (uintptr_t)stack + size,
+                                                buf, CoroutineRegistry::kMaxBacktrace);
+        frames.assign(buf, buf + depth);
+#else
+        (void)ctx;
+        (void)stack;
+        (void)size;
+        (void)frames;
+#endif
+    }
+
+    void DumperMain()
+    {
+        RegistryState &state = GetState();
+        while (true)
+        {
+            if (sem_wait(&state.dumpSem) && errno == EINTR)
+            {
+                continue;
+            }
+            CoroutineRegistry::Dump(state.dumpFd);
+        }
+    }
+
+    void OnDumpSignal(int)
+    {
+        // 信号处理函数里只能做异步信号安全的事
+        int saved = errno;
+        sem_post(&GetState().dumpSem);
+        errno = saved;
+    }
+}
+
+void CoroutineRegistry::Register(Coroutine *co)
+{
+    RegistryShard *shard = GetShard();
+    Spinlock::Lock lock(shard->lock);
+    co->m_registryShard = shard;
+    co->m_registryPrev = nullptr;
+    co->m_registryNext = shard->head;
+    if (shard->head)
+    {
+        shard->head->m_registryPrev = co;
+    }
+    shard->head = co;
+    ++shard->count;
+}
+
+void CoroutineRegistry::Unregister(Coroutine *co)
+{
+    RegistryShard *shard = (RegistryShard *)co->m_registryShard;
+    if (!shard)
+    {
+        return;
+    }
+    Spinlock::Lock lock(shard->lock);
+    if (co->m_registryPrev)
+    {
+        co->m_registryPrev->m_registryNext = co->m_registryNext;
+    }
+    else
+    {
+        shard->head = co->m_registryNext;
+    }
+    if (co->m_registryNext)
+    {
+        co->m_registryNext->m_registryPrev = co->m_registryPrev;
+    }
+    co->m_registryPrev = co->m_registryNext = nullptr;
+    co->m_registryShard = nullptr;
+    --shard->count;
+}
+
+size_t CoroutineRegistry::Count()
+{
+    RegistryState &state = GetState();
+    Mutex::Lock lock(state.mutex);
+    size_t count = 0;
+    for (auto shard : state.shards)
+    {
+        Spinlock::Lock shard_lock(shard->lock);
+        count += shard->count;
+    }
+    return count;
+}
+
+void CoroutineRegistry::Collect(Coroutine *co, uint64_t now, bool with_backtrace, CoroutineInfo &info)
+{
+    info.id = co->m_id;
+    info.state = co->m_state;
+    info.scheduler = co->m_scheduler;
+    info.waitReason = co->m_waitReason;
+    info.label = co->m_label;
+    info.stateUS = now > co->m_stateSinceUS ? now - co->m_stateSinceUS : 0;
+    info.stackSize = co->m_stacksize;
+    if (co->m_stack)
+    {
+        info.stackUsed = StackHighWater(co->m_stack, co->m_stacksize);
+        // 只有挂起的协程保存的上下文才有意义，正在运行的协程寄存器在别的线程上
+        if (with_backtrace && info.state == Coroutine::READY)
+        {
+            UnwindContext(co->m_context, co->m_stack, co->m_stacksize, info.backtrace);
+        }
+    }
+}
+
+std::vector<CoroutineInfo> CoroutineRegistry::Snapshot(bool with_backtrace)
+{
+    std::vector<CoroutineInfo> infos;
+    uint64_t now = ybb::GetCoarseUS();
+    RegistryState &state = GetState();
+    Mutex::Lock lock(state.mutex);
+    for (auto shard : state.shards)
+    {
+        // 持有分片锁期间协程不会被析构，栈也不会被释放
+        Spinlock::Lock shard_lock(shard->lock);
+        for (Coroutine *co = shard->head; co; co = co->m_registryNext)
+        {
+            infos.emplace_back();
+            Collect(co, now, with_backtrace, infos.back());
+        }
+    }
+    return infos;
+}
+
+void CoroutineRegistry::Dump(int fd, bool with_backtrace)
+{
+    std::vector<CoroutineInfo> infos = Snapshot(with_backtrace);
+    dprintf(fd, "==== %zu coroutines ====\n", infos.size());
+    for (auto &info : infos)
+    {
+        dprintf(fd, "coroutine %lu %s label=%s scheduler=%p wait=%s for %.3fs stack=%zu/%zu\n",
+                info.id, StateName(info.state), info.label ? info.label : "-", (void *)info.scheduler,
+                info.waitReason ? info.waitReason : "-", info.stateUS / 1e6,
+                info.stackUsed, info.stackSize);
+        if (info.backtrace.empty())
+        {
+            continue;
+        }
+        char **symbols = backtrace_symbols(info.backtrace.data(), info.backtrace.size());
+        for (size_t i = 0; i < info.backtrace.size(); i++)
+        {
+            dprintf(fd, "    #%zu %p %s\n", i, info.backtrace[i], symbols ? symbols[i] : "");
+        }
+        free(symbols);
+    }
+}
+
+void CoroutineRegistry::InstallSignalHandler(int signo, int fd)
+{
+    RegistryState &state = GetState();
+    {
+        Mutex::Lock lock(state.mutex);
+        state.dumpFd = fd;
+        if (!state.dumper)
+        {
+            sem_init(&state.dumpSem, 0, 0);
+            state.dumper = new Thread(&DumperMain, "co_dumper");
+        }
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &OnDumpSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(signo, &sa, nullptr))
+    {
+        YBB_LOG_ERROR("sigaction %d failed: %s", signo, strerror(errno));
+    }
+}
+
+const char *CoroutineRegistry::StateName(Coroutine::State state)
+{
+    switch (state)
+    {
+    case Coroutine::READY:
+        return "READY";
+    case Coroutine::RUNNING:
+        return "RUNNING";
+    case Coroutine::TERM:
+        return "TERM";
+    default:
+        return "UNKNOW";
+    }
+}
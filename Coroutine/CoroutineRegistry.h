@@ -0,0 +1,103 @@
+/**
+ * @file CoroutineRegistry.h
+ * @brief 协程注册表
+ * @details 记录所有存活的Coroutine，用于排查卡死和协程泄漏。
+ * 协程对象自带侵入式链表节点，挂在创建它的线程的分片链表上，
+ * 创建和析构只锁一个基本不会争抢的分片自旋锁；
+ * 导出时逐个分片加锁遍历，列出id、状态、所属调度器、等待原因、
+ * 处于当前状态的时间、栈使用的最高水位，以及挂起协程的调用栈。
+ * 调用栈通过保存的上下文中的rbp沿帧指针回溯，需要编译时保留帧指针(-O0或-fno-omit-frame-pointer)
+ */
+#ifndef __COROUTINE_REGISTRY_H__
+#define __COROUTINE_REGISTRY_H__
+
+#include "Coroutine.h"
+#include <signal.h>
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief 一个协程的诊断信息
+ */
+struct CoroutineInfo
+{
+    uint64_t id = 0;
+    Coroutine::State state = Coroutine::READY;
+    // 最近一次运行该协程的调度器
+    SchedulerBase *scheduler = nullptr;
+    // 等待原因，可能为nullptr
+    const char *waitReason = nullptr;
+    // 任务标签，可能为nullptr
+    const char *label = nullptr;
+    // 处于当前状态的时间(微秒)
+    uint64_t stateUS = 0;
+    // 栈大小，主协程为0
+    size_t stackSize = 0;
+    // 栈使用的最高水位
+    size_t stackUsed = 0;
+    // 挂起位置的调用栈(返回地址)，只有就绪的子协程才有
+    std::vector<void *> backtrace;
+};
+
+/**
+ * @brief 协程注册表
+ */
+class CoroutineRegistry
+{
+public:
+    /// 回溯的最大帧数
+    static const size_t kMaxBacktrace = 32;
+
+    /**
+     * @brief 登记协程，由Coroutine的构造函数调用
+     */
+    static void Register(Coroutine *co);
+
+    /**
+     * @brief 注销协程，由Coroutine的析构函数调用
+     */
+    static void Unregister(Coroutine *co);
+
+    /**
+     * @brief 存活的协程数
+     */
+    static size_t Count();
+
+    /**
+     * @brief 获取所有存活协程的诊断信息
+     * @details 正在其他线程上运行的协程状态可能随时变化，结果只是一个近似的快照
+     * @param[in] with_backtrace 是否回溯挂起协程的调用栈
+     */
+    static std::vector<CoroutineInfo> Snapshot(bool with_backtrace = true);
+
+    /**
+     * @brief 把所有存活协程的诊断信息写到fd
+     * @param[in] fd 输出的文件描述符
+     * @param[in] with_backtrace 是否回溯挂起协程的调用栈
+     */
+    static void Dump(int fd = STDERR_FILENO, bool with_backtrace = true);
+
+    /**
+     * @brief 安装信号触发的导出
+     * @details 信号处理函数只做sem_post，由后台的导出线程调用Dump，
+     * 进程卡住时可以用kill -USR1 <pid>查看所有协程
+     * @param[in] signo 触发的信号
+     * @param[in] fd 输出的文件描述符
+     */
+    static void InstallSignalHandler(int signo = SIGUSR1, int fd = STDERR_FILENO);
+
+    /**
+     * @brief 状态的名字
+     */
+    static const char *StateName(Coroutine::State state);
+
+private:
+    /**
+     * @brief 采集一个协程的诊断信息，调用时必须持有它所在分片的锁
+     */
+    static void Collect(Coroutine *co, uint64_t now, bool with_backtrace, CoroutineInfo &info);
+};
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file StackUnwind.h
+ * @brief 沿帧指针回溯协程栈
+ * @details 只读[lo, hi)范围内的内存，栈内容被破坏或者不是帧指针时提前停止，不会越界访问，
+ * 可以在信号处理函数中使用。依赖帧指针，优化编译时需要-fno-omit-frame-pointer
+ */
+#ifndef __STACK_UNWIND_H__
+#define __STACK_UNWIND_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ybb
+{
+    /**
+     * @brief 从pc/fp开始回溯
+     * @param[in] pc 当前指令地址，作为第一帧
+     * @param[in] fp 当前帧指针
+     * @param[in] lo 栈的低地址
+     * @param[in] hi 栈的高地址(不含)
+     * @param[out] frames 返回地址
+     * @param[in] max frames的容量
+     * @return 帧数
+     */
+    inline size_t UnwindFramePointers(uintptr_t pc, uintptr_t fp, uintptr_t lo, uintptr_t hi,
+                                      void **frames, size_t max)
+    {
+        size_t depth = 0;
+        if (max == 0)
+        {
+            return 0;
+        }
+        frames[depth++] = (void *)pc;
+        while (depth < max && fp >= lo && fp + 2 * sizeof(void *) <= hi && fp % sizeof(void *) == 0)
+        {
+            void **frame = (void **)fp;
+            if (!frame[1])
+            {
+                break;
+            }
+            frames[depth++] = frame[1];
+            uintptr_t next = (uintptr_t)frame[0];
+            // 栈向低地址增长，上一层的帧一定在更高的地址
+            if (next <= fp)
+            {
+                break;
+            }
+            fp = next;
+        }
+        return depth;
+    }
+}
+
+#endif
@@ -0,0 +1,366 @@
+#include "Log.h"
+#include "../Mutex/SpscRing.h"
+#include "../Thread/Threads.h"
+#include "../Coroutine/Coroutine.h"
+#include "../util.h"
+#include <sys/uio.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+// 每个线程的日志队列容量
+static const size_t kRingCapacity = 1024;
+// 单条日志消息的最大长度，超出部分截断
+static const size_t kMaxMessage = 256;
+// 单条日志格式化后的最大长度
+static const size_t kMaxLine = kMaxMessage + 128;
+// 每次writev最多写出的日志条数
+static const size_t kMaxBatch = 64;
+// 后台线程没有日志可写时的睡眠时间(微秒)
+static const useconds_t kIdleSleepUS = 1000;
+
+namespace
+{
+    /**
+     * @brief 一条日志
+     */
+    struct LogRecord
+    {
+        // 墙上时间(微秒)
+        uint64_t timeUS;
+        uint64_t coroutineId;
+        pid_t tid;
+        int level;
+        const char *file;
+        int line;
+        char thread[16];
+        char msg[kMaxMessage];
+    };
+
+    /**
+     * @brief 一个线程的日志队列
+     */
+    struct LogRing
+    {
+        SpscRing<LogRecord> ring{kRingCapacity};
+        // 所属线程已经退出，队列写空后回收
+        std::atomic<bool> closed{false};
+    };
+
+    /**
+     * @brief 全局日志状态
+     */
+    struct LogState
+    {
+        // 所有线程的日志队列
+        Mutex mutex;
+        std::vector<LogRing *> rings;
+        // 后台写线程
+        Thread *writer = nullptr;
+        std::atomic<bool> started{false};
+        std::atomic<bool> stopping{false};
+        // 后台线程正在取日志和写出
+        std::atomic<bool> busy{false};
+        std::atomic<int> fd{STDOUT_FILENO};
+        std::atomic<uint64_t> dropped{0};
+        uint64_t reportedDropped = 0;
+    };
+
+    LogState &GetState()
+    {
+        // 故意不析构，进程退出过程中其他线程可能还在写日志
+        static LogState *state = new LogState;
+        return *state;
+    }
+
+    // 以下线程局部变量都没有析构函数，线程退出过程中(包括其他线程局部对象析构时)也可以安全访问
+    thread_local LogRing *t_ring = nullptr;
+    thread_local bool t_ring_closed = false;
+    thread_local pid_t t_tid = 0;
+    thread_local char t_thread_name[16] = "UNKNOW";
+
+    /**
+     * @brief 线程退出时把自己的队列标记为关闭
+     */
+    struct RingGuard
+    {
+        ~RingGuard()
+        {
+            if (t_ring)
+            {
+                t_ring->closed = true;
+                t_ring = nullptr;
+            }
+            t_ring_closed = true;
+        }
+    };
+
+    /**
+     * @brief 格式化一条日志
+     * @return 长度
+     */
+    size_t FormatRecord(const LogRecord &record, char *buf, size_t size)
+    {
+        time_t sec = record.timeUS / 1000000;
+        struct tm tm;
+        localtime_r(&sec, &tm);
+        char time_buf[32];
+        strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm);
+        const char *file = strrchr(record.file, '/');
+        int n = snprintf(buf, size, "%s.%06lu %-5s %d %s %lu [%s:%d] %s\n",
+                         time_buf, record.timeUS % 1000000, LogLevel::ToString(record.level),
+                         record.tid, record.thread, record.coroutineId,
+                         file ? file + 1 : record.file, record.line, record.msg);
+        if (n < 0)
+        {
+            return 0;
+        }
+        if ((size_t)n >= size)
+        {
+            buf[size - 2] = '\n';
+            return size - 1;
+        }
+        return n;
+    }
+
+    /**
+     * @brief 填写日志的公共字段
+     */
+    void FillRecord(LogRecord &record, int level, const char *file, int line, const char *fmt, va_list ap)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        if (!t_tid)
+        {
+            t_tid = ybb::GetThreadId();
+        }
+        record.timeUS = ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+        record.coroutineId = Coroutine::GetCoroutineId();
+        record.tid = t_tid;
+        record.level = level;
+        record.file = file;
+        record.line = line;
+        memcpy(record.thread, t_thread_name, sizeof(record.thread));
+        vsnprintf(record.msg, sizeof(record.msg), fmt, ap);
+    }
+
+    /**
+     * @brief 取出所有队列中的日志并写出
+     * @return 写出的条数
+     */
+    size_t Drain()
+    {
+        LogState &state = GetState();
+        static char lines[kMaxBatch][kMaxLine];
+        struct iovec iov[kMaxBatch];
+        size_t count = 0;
+        size_t total = 0;
+        int fd = state.fd;
+
+        state.busy = true;
+        {
+            Mutex::Lock lock(state.mutex);
+            for (auto it = state.rings.begin(); it != state.rings.end();)
+            {
+                LogRing *ring = *it;
+                // 先读closed再取日志，保证关闭前写入的日志都能取到
+                bool closed = ring->closed.load(std::memory_order_acquire);
+                LogRecord record;
+                while (ring->ring.pop(record))
+                {
+                    iov[count].iov_base = lines[count];
+                    iov[count].iov_len = FormatRecord(record, lines[count], kMaxLine);
+                    if (++count == kMaxBatch)
+                    {
+                        writev(fd, iov, count);
+                        total += count;
+                        count = 0;
+                    }
+                }
+                if (closed)
+                {
+                    delete ring;
+                    it = state.rings.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        if (count)
+        {
+            writev(fd, iov, count);
+            total += count;
+        }
+        uint64_t dropped = state.dropped;
+        if (dropped != state.reportedDropped)
+        {
+            dprintf(fd, "[log] %lu records dropped\n", dropped - state.reportedDropped);
+            state.reportedDropped = dropped;
+        }
+        state.busy = false;
+        return total;
+    }
+
+    void WriterMain()
+    {
+        LogState &state = GetState();
+        while (!state.stopping)
+        {
+            if (Drain() == 0)
+            {
+                usleep(kIdleSleepUS);
+            }
+        }
+        Drain();
+    }
+
+    /**
+     * @brief 进程退出时停止后台线程，把剩下的日志写完，之后的日志同步写出
+     */
+    void StopWriter()
+    {
+        LogState &state = GetState();
+        state.stopping = true;
+        if (state.writer)
+        {
+            state.writer->join();
+        }
+    }
+
+    void StartWriter()
+    {
+        LogState &state = GetState();
+        Mutex::Lock lock(state.mutex);
+        if (state.started)
+        {
+            return;
+        }
+        state.writer = new Thread(&WriterMain, "log_writer");
+        atexit(&StopWriter);
+        state.started = true;
+    }
+
+    /**
+     * @brief 获取当前线程的日志队列，线程已经退出或者后台线程已经停止时返回nullptr
+     */
+    LogRing *GetRing()
+    {
+        if (t_ring)
+        {
+            return t_ring;
+        }
+        LogState &state = GetState();
+        if (t_ring_closed || state.stopping)
+        {
+            return nullptr;
+        }
+        if (!state.started)
+        {
+            StartWriter();
+        }
+        static thread_local RingGuard guard;
+        (void)guard;
+        LogRing *ring = new LogRing;
+        {
+            Mutex::Lock lock(state.mutex);
+            state.rings.push_back(ring);
+        }
+        t_ring = ring;
+        return ring;
+    }
+}
+
+const char *LogLevel::ToString(int level)
+{
+    switch (level)
+    {
+    case DEBUG:
+        return "DEBUG";
+    case INFO:
+        return "INFO";
+    case WARN:
+        return "WARN";
+    case ERROR:
+        return "ERROR";
+    case FATAL:
+        return "FATAL";
+    default:
+        return "UNKNOW";
+    }
+}
+
+void Logger::Log(int level, const char *file, int line, const char *fmt, ...)
+{
+    LogRing *ring = GetRing();
+    LogRecord record;
+    va_list ap;
+    va_start(ap, fmt);
+    FillRecord(record, level, file, line, fmt, ap);
+    va_end(ap);
+
+    if (!ring)
+    {
+        // 进程退出阶段，直接同步写
+        char buf[kMaxLine];
+        size_t len = FormatRecord(record, buf, sizeof(buf));
+        write(GetState().fd, buf, len);
+        return;
+    }
+    if (!ring->ring.push(record))
+    {
+        GetState().dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (level >= LogLevel::FATAL)
+    {
+        Flush();
+    }
+}
+
+void Logger::SetFd(int fd)
+{
+    GetState().fd = fd;
+}
+
+void Logger::SetThreadName(const char *name)
+{
+    strncpy(t_thread_name, name, sizeof(t_thread_name) - 1);
+    t_thread_name[sizeof(t_thread_name) - 1] = '\0';
+}
+
+void Logger::Flush()
+{
+    LogState &state = GetState();
+    if (!state.started || state.stopping)
+    {
+        return;
+    }
+    while (true)
+    {
+        bool empty = true;
+        {
+            Mutex::Lock lock(state.mutex);
+            for (auto ring : state.rings)
+            {
+                if (!ring->ring.empty())
+                {
+                    empty = false;
+                    break;
+                }
+            }
+        }
+        if (empty && !state.busy)
+        {
+            return;
+        }
+        usleep(100);
+    }
+}
+
+uint64_t Logger::Dropped()
+{
+    return GetState().dropped;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file Log.h
+ * @brief 异步日志
+ * @details 编译期按级别过滤，低于YBB_LOG_LEVEL的日志语句整个被编译器去掉，参数也不会求值；
+ * 通过过滤的日志在调用线程格式化后写入该线程自己的无锁环形队列，
+ * 由后台线程批量取出，用writev一次写出，调用线程不加锁也不进入内核。
+ * 每条日志带有时间戳、线程id、线程名和协程id
+ */
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <sys/types.h>
+
+/**
+ * @brief 日志级别
+ */
+class LogLevel
+{
+public:
+    enum Level
+    {
+        DEBUG = 0,
+        INFO = 1,
+        WARN = 2,
+        ERROR = 3,
+        FATAL = 4,
+        // 关闭所有日志
+        OFF = 5
+    };
+
+    /**
+     * @brief 级别的名字
+     */
+    static const char *ToString(int level);
+};
+
+/// 编译期日志级别，低于该级别的日志不会被编译进来，可以用-DYBB_LOG_LEVEL=0打开DEBUG日志
+#ifndef YBB_LOG_LEVEL
+#define YBB_LOG_LEVEL 1
+#endif
+
+/**
+ * @brief 日志器
+ */
+class Logger
+{
+public:
+    /**
+     * @brief 记录一条日志，一般通过YBB_LOG_XXX宏调用
+     * @param[in] level 日志级别
+     * @param[in] file 文件名
+     * @param[in] line 行号
+     * @param[in] fmt printf格式串
+     */
+    static void Log(int level, const char *file, int line, const char *fmt, ...)
+        __attribute__((format(printf, 4, 5)));
+
+    /**
+     * @brief 设置日志输出的文件描述符，默认为标准输出
+     */
+    static void SetFd(int fd);
+
+    /**
+     * @brief 设置当前线程在日志中显示的名字，由Thread自动调用
+     */
+    static void SetThreadName(const char *name);
+
+    /**
+     * @brief 等待当前所有线程已提交的日志写出
+     */
+    static void Flush();
+
+    /**
+     * @brief 因为队列满被丢弃的日志条数
+     */
+    static uint64_t Dropped();
+};
+
+#define YBB_LOG(level, fmt, ...)                                          \
+    do                                                                    \
+    {                                                                     \
+        if ((level) >= YBB_LOG_LEVEL)                                     \
+        {                                                                 \
+            Logger::Log(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__);   \
+        }                                                                 \
+    } while (0)
+
+#define YBB_LOG_DEBUG(fmt, ...) YBB_LOG(LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+#define YBB_LOG_INFO(fmt, ...) YBB_LOG(LogLevel::INFO, fmt, ##__VA_ARGS__)
+#define YBB_LOG_WARN(fmt, ...) YBB_LOG(LogLevel::WARN, fmt, ##__VA_ARGS__)
+#define YBB_LOG_ERROR(fmt, ...) YBB_LOG(LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#define YBB_LOG_FATAL(fmt, ...) YBB_LOG(LogLevel::FATAL, fmt, ##__VA_ARGS__)
+
+#endif
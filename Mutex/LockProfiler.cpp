@@ -0,0 +1,127 @@
+#include "LockProfiler.h"
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <stdio.h>
+
+// 等待时间超过这个值才算发生了竞争(纳秒)，低于它的基本是取时间本身的开销
+static const uint64_t kContendedThresholdNS = 200;
+
+namespace
+{
+    /**
+     * @brief 线程局部的统计缓冲区
+     * @details 只有所属线程写入，汇总时才会有其他线程读，所以自旋锁基本无竞争；
+     * 线程退出后缓冲区仍由注册表持有，数据不会丢失
+     */
+    struct ThreadBuffer
+    {
+        Spinlock mutex;
+        std::unordered_map<const char *, LockStat> stats;
+    };
+
+    /**
+     * @brief 所有线程缓冲区的注册表
+     */
+    struct Registry
+    {
+        Mutex mutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    };
+
+    Registry &GetRegistry()
+    {
+        // 故意不析构，其他线程退出时还可能访问
+        static Registry *registry = new Registry;
+        return *registry;
+    }
+
+    ThreadBuffer &GetThreadBuffer()
+    {
+        static thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer)
+        {
+            buffer = std::make_shared<ThreadBuffer>();
+            Registry &registry = GetRegistry();
+            Mutex::Lock lock(registry.mutex);
+            registry.buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+}
+
+void LockProfiler::Record(const char *name, uint64_t wait_ns, uint64_t hold_ns)
+{
+    ThreadBuffer &buffer = GetThreadBuffer();
+    Spinlock::Lock lock(buffer.mutex);
+    LockStat &stat = buffer.stats[name];
+    ++stat.acquires;
+    if (wait_ns > kContendedThresholdNS)
+    {
+        ++stat.contended;
+    }
+    stat.waitNs += wait_ns;
+    stat.maxWaitNs = std::max(stat.maxWaitNs, wait_ns);
+    stat.holdNs += hold_ns;
+}
+
+std::vector<LockStat> LockProfiler::Collect()
+{
+    // 同名的锁可能在不同编译单元里有不同的字符串地址，按内容合并
+    std::map<std::string, LockStat> merged;
+    Registry &registry = GetRegistry();
+    Mutex::Lock lock(registry.mutex);
+    for (auto &buffer : registry.buffers)
+    {
+        Spinlock::Lock buffer_lock(buffer->mutex);
+        for (auto &i : buffer->stats)
+        {
+            LockStat &stat = merged[i.first];
+            stat.acquires += i.second.acquires;
+            stat.contended += i.second.contended;
+            stat.waitNs += i.second.waitNs;
+            stat.maxWaitNs = std::max(stat.maxWaitNs, i.second.maxWaitNs);
+            stat.holdNs += i.second.holdNs;
+        }
+    }
+    std::vector<LockStat> result;
+    for (auto &i : merged)
+    {
+        i.second.name = i.first;
+        result.push_back(i.second);
+    }
+    std::sort(result.begin(), result.end(), [](const LockStat &a, const LockStat &b) {
+        return a.waitNs > b.waitNs;
+    });
+    return result;
+}
+
+std::string LockProfiler::Report(size_t top)
+{
+    std::vector<LockStat> stats = Collect();
+    std::string report;
+    char line[512];
+    snprintf(line, sizeof(line), "%-40s %10s %10s %12s %12s %12s %12s\n",
+             "lock", "acquires", "contended", "wait(us)", "avg wait(ns)", "max wait(ns)", "avg hold(ns)");
+    report += line;
+    for (size_t i = 0; i < stats.size() && i < top; i++)
+    {
+        const LockStat &stat = stats[i];
+        snprintf(line, sizeof(line), "%-40s %10lu %10lu %12lu %12lu %12lu %12lu\n",
+                 stat.name.c_str(), stat.acquires, stat.contended, stat.waitNs / 1000,
+                 stat.waitNs / stat.acquires, stat.maxWaitNs, stat.holdNs / stat.acquires);
+        report += line;
+    }
+    return report;
+}
+
+void LockProfiler::Reset()
+{
+    Registry &registry = GetRegistry();
+    Mutex::Lock lock(registry.mutex);
+    for (auto &buffer : registry.buffers)
+    {
+        Spinlock::Lock buffer_lock(buffer->mutex);
+        buffer->stats.clear();
+    }
+}
@@ -0,0 +1,179 @@
+/**
+ * @file LockProfiler.h
+ * @brief 锁竞争分析
+ * @details 定义LOCK_PROFILING编译时，SCOPED_LOCK等宏展开为带统计的范围锁，
+ * 按锁名(默认是调用位置)记录加锁次数、等待时间和持有时间，
+ * 数据写入线程局部的缓冲区，需要时汇总并输出竞争最严重的锁；
+ * 未定义时宏展开为普通的ScopedLockImpl，没有任何额外开销
+ */
+#ifndef __LOCK_PROFILER_H__
+#define __LOCK_PROFILER_H__
+
+#include "Mutex.h"
+#include <time.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 一把锁(或一个加锁位置)的统计数据
+ */
+struct LockStat
+{
+    /// 锁名或调用位置
+    std::string name;
+    /// 加锁次数
+    uint64_t acquires = 0;
+    /// 发生竞争(等待时间超过阈值)的加锁次数
+    uint64_t contended = 0;
+    /// 总等待时间(纳秒)
+    uint64_t waitNs = 0;
+    /// 最大等待时间(纳秒)
+    uint64_t maxWaitNs = 0;
+    /// 总持有时间(纳秒)
+    uint64_t holdNs = 0;
+};
+
+/**
+ * @brief 锁竞争统计
+ */
+class LockProfiler
+{
+public:
+    /**
+     * @brief 单调时钟的当前时间(纳秒)
+     */
+    static uint64_t NowNS()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+    }
+
+    /**
+     * @brief 记录一次加锁，写入当前线程的缓冲区
+     * @param[in] name 锁名，必须是生命周期足够长的字符串(通常是字面量)
+     * @param[in] wait_ns 等待时间
+     * @param[in] hold_ns 持有时间
+     */
+    static void Record(const char *name, uint64_t wait_ns, uint64_t hold_ns);
+
+    /**
+     * @brief 汇总所有线程的数据，按总等待时间从大到小排序
+     */
+    static std::vector<LockStat> Collect();
+
+    /**
+     * @brief 生成竞争最严重的top把锁的报告
+     */
+    static std::string Report(size_t top = 10);
+
+    /**
+     * @brief 清空所有线程的数据
+     */
+    static void Reset();
+};
+
+/**
+ * @brief 带统计的局部锁模板实现
+ * @tparam T 锁类型
+ * @tparam Mode 0互斥锁，1读锁，2写锁
+ */
+template <class T, int Mode>
+struct ProfiledLockImpl
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] mutex 锁
+     * @param[in] name 锁名或调用位置
+     */
+    ProfiledLockImpl(T &mutex, const char *name)
+        : m_mutex(mutex), m_name(name)
+    {
+        m_locked = false;
+        lock();
+    }
+
+    /**
+     * @brief 析构函数,自动释放锁
+     */
+    ~ProfiledLockImpl()
+    {
+        unlock();
+    }
+
+    /**
+     * @brief 加锁
+     */
+    void lock()
+    {
+        if (!m_locked)
+        {
+            uint64_t begin = LockProfiler::NowNS();
+            if constexpr (Mode == 1)
+            {
+                m_mutex.rdlock();
+            }
+            else if constexpr (Mode == 2)
+            {
+                m_mutex.wrlock();
+            }
+            else
+            {
+                m_mutex.lock();
+            }
+            m_acquired = LockProfiler::NowNS();
+            m_wait = m_acquired - begin;
+            m_locked = true;
+        }
+    }
+
+    /**
+     * @brief 解锁，记录本次的等待和持有时间
+     */
+    void unlock()
+    {
+        if (m_locked)
+        {
+            m_mutex.unlock();
+            m_locked = false;
+            LockProfiler::Record(m_name, m_wait, LockProfiler::NowNS() - m_acquired);
+        }
+    }
+
+private:
+    /// mutex
+    T &m_mutex;
+    /// 锁名
+    const char *m_name;
+    /// 是否已上锁
+    bool m_locked;
+    /// 本次等待时间
+    uint64_t m_wait = 0;
+    /// 拿到锁的时间
+    uint64_t m_acquired = 0;
+};
+
+#define LOCK_PROFILER_STR2(x) #x
+#define LOCK_PROFILER_STR(x) LOCK_PROFILER_STR2(x)
+/// 当前调用位置，作为默认的锁名
+#define LOCK_SITE __FILE__ ":" LOCK_PROFILER_STR(__LINE__)
+
+#ifdef LOCK_PROFILING
+#define SCOPED_LOCK_NAMED(type, var, mutex, name) ProfiledLockImpl<type, 0> var(mutex, name)
+#define READ_SCOPED_LOCK_NAMED(type, var, mutex, name) ProfiledLockImpl<type, 1> var(mutex, name)
+#define WRITE_SCOPED_LOCK_NAMED(type, var, mutex, name) ProfiledLockImpl<type, 2> var(mutex, name)
+#else
+#define SCOPED_LOCK_NAMED(type, var, mutex, name) ScopedLockImpl<type> var(mutex)
+#define READ_SCOPED_LOCK_NAMED(type, var, mutex, name) ReadScopedLockImpl<type> var(mutex)
+#define WRITE_SCOPED_LOCK_NAMED(type, var, mutex, name) WriteScopedLockImpl<type> var(mutex)
+#endif
+
+/// 局部锁，以调用位置为锁名
+#define SCOPED_LOCK(type, var, mutex) SCOPED_LOCK_NAMED(type, var, mutex, LOCK_SITE)
+/// 局部读锁，以调用位置为锁名
+#define READ_SCOPED_LOCK(type, var, mutex) READ_SCOPED_LOCK_NAMED(type, var, mutex, LOCK_SITE)
+/// 局部写锁，以调用位置为锁名
+#define WRITE_SCOPED_LOCK(type, var, mutex) WRITE_SCOPED_LOCK_NAMED(type, var, mutex, LOCK_SITE)
+
+#endif
@@ -1,6 +1,6 @@
 /**
  * @file Mutex.h
- * @brief 信号量，互斥锁，读写锁，范围锁模板，自旋锁，原子锁
+ * @brief 信号量，互斥锁，读写锁，范围锁模板，自旋锁，原子锁，futex锁，排队锁
  * @version 0.1
  * @date 2021-06-09
  */
@@ -11,15 +11,56 @@
 #include <functional>
 #include <memory>
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdint.h>
 #include <atomic>
 #include <list>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <linux/futex.h>
 
 #include "noncopyable.h"
 
+/**
+ * @brief 自旋等待时提示CPU，降低功耗并让出超线程的执行资源
+ */
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+/**
+ * @brief 在futex上等待，*addr不等于expected时立即返回
+ * @param[in] timeout 相对超时时间，nullptr为一直等待
+ */
+inline long FutexWait(std::atomic<int> *addr, int expected, const struct timespec *timeout = nullptr)
+{
+    return syscall(SYS_futex, reinterpret_cast<int *>(addr), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+}
+
+/**
+ * @brief 唤醒在futex上等待的线程
+ * @param[in] count 最多唤醒的线程数
+ */
+inline long FutexWake(std::atomic<int> *addr, int count)
+{
+    return syscall(SYS_futex, reinterpret_cast<int *>(addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
 /**
  * @brief 信号量
+ * @details 基于futex实现，计数大于0时获取和释放都只有原子操作，
+ * 只有真的需要睡眠或者有人在睡眠时才进入内核。
+ * 计数和睡眠的线程数放在同一个64位字里，低32位是计数(futex等待在这半个字上)，高32位是睡眠的线程数：
+ * notify()根据自己那次原子加法返回的旧值决定要不要唤醒，加法之后只用提前取好的地址调用futex唤醒，
+ * 不再读写信号量，拿到计数的线程马上析构信号量也是安全的，和sem_t一样
  */
 class Semaphore : Noncopyable
 {
@@ -29,13 +70,8 @@ public:
      * @param[in] count 信号量值的大小
      */
     Semaphore(uint32_t count = 0)
+        : m_data(count)
     {
-        {
-            if (sem_init(&m_semaphore, 0, count))
-            {
-                throw std::logic_error("sem_init error");
-            }
-        }
     }
 
     /**
@@ -43,7 +79,6 @@ public:
      */
     ~Semaphore()
     {
-        sem_destroy(&m_semaphore);
     }
 
     /**
@@ -51,12 +86,71 @@ public:
      */
     void wait()
     {
+        if (tryWait())
         {
-            if (sem_wait(&m_semaphore))
+            return;
+        }
+        m_data.fetch_add(kOneWaiter, std::memory_order_relaxed);
+        // 计数仍为0才睡眠，被唤醒或者计数已变化就重试
+        while (!takeAndLeave())
+        {
+            FutexWait(valueWord(), 0);
+        }
+    }
+
+    /**
+     * @brief 获取信号量，最多等待timeout_us微秒
+     * @return 超时返回false
+     */
+    bool waitFor(uint64_t timeout_us)
+    {
+        if (tryWait())
+        {
+            return true;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t deadline = now.tv_sec * 1000000ul + now.tv_nsec / 1000 + timeout_us;
+        m_data.fetch_add(kOneWaiter, std::memory_order_relaxed);
+        while (!takeAndLeave())
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            uint64_t cur = now.tv_sec * 1000000ul + now.tv_nsec / 1000;
+            if (cur >= deadline)
             {
-                throw std::logic_error("sem_wait error");
+                // 超时，撤销登记；撤销之前来了计数就拿走
+                uint64_t d = m_data.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    uint64_t next = (d & kValueMask) ? d - 1 - kOneWaiter : d - kOneWaiter;
+                    if (m_data.compare_exchange_weak(d, next, std::memory_order_acquire, std::memory_order_relaxed))
+                    {
+                        return (d & kValueMask) != 0;
+                    }
+                }
             }
+            struct timespec left;
+            left.tv_sec = (deadline - cur) / 1000000;
+            left.tv_nsec = (deadline - cur) % 1000000 * 1000;
+            FutexWait(valueWord(), 0, &left);
         }
+        return true;
+    }
+
+    /**
+     * @brief 尝试获取信号量，不阻塞
+     */
+    bool tryWait()
+    {
+        uint64_t d = m_data.load(std::memory_order_relaxed);
+        while (d & kValueMask)
+        {
+            if (m_data.compare_exchange_weak(d, d - 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
     }
 
     /**
@@ -64,16 +158,96 @@ public:
      */
     void notify()
     {
+        // 加法之后信号量随时可能被拿到计数的线程析构
+        std::atomic<int> *word = valueWord();
+        if (m_data.fetch_add(1, std::memory_order_release) >> kWaiterShift)
+        {
+            FutexWake(word, 1);
+        }
+    }
+
+private:
+    static const int kWaiterShift = 32;
+    static const uint64_t kOneWaiter = 1ul << kWaiterShift;
+    static const uint64_t kValueMask = kOneWaiter - 1;
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "futex needs a plain 64-bit word");
+
+    /**
+     * @brief 已登记睡眠的线程拿走一个计数，同时撤销登记
+     */
+    bool takeAndLeave()
+    {
+        uint64_t d = m_data.load(std::memory_order_relaxed);
+        while (d & kValueMask)
         {
-            if (sem_post(&m_semaphore))
+            if (m_data.compare_exchange_weak(d, d - 1 - kOneWaiter, std::memory_order_acquire,
+                                             std::memory_order_relaxed))
             {
-                throw std::logic_error("sem_post error");
+                return true;
             }
         }
+        return false;
+    }
+
+    /**
+     * @brief 计数所在的32位，futex在它上面等待和唤醒
+     */
+    std::atomic<int> *valueWord()
+    {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return reinterpret_cast<std::atomic<int> *>(&m_data);
+#else
+        return reinterpret_cast<std::atomic<int> *>(&m_data) + 1;
+#endif
+    }
+
+private:
+    /// 低32位为信号量的值，高32位为登记睡眠的线程数
+    std::atomic<uint64_t> m_data;
+};
+
+/**
+ * @brief 倒计数门闩
+ * @details 计数减到0时唤醒所有等待者，用于一次等待一批线程就绪
+ */
+class CountDownLatch : Noncopyable
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] count 需要countDown的次数
+     */
+    CountDownLatch(uint32_t count)
+        : m_count(count)
+    {
+    }
+
+    /**
+     * @brief 计数减一，减到0时唤醒所有等待者
+     */
+    void countDown()
+    {
+        if (m_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            FutexWake(&m_count, INT32_MAX);
+        }
+    }
+
+    /**
+     * @brief 等待计数减到0
+     */
+    void wait()
+    {
+        int c;
+        while ((c = m_count.load(std::memory_order_acquire)) > 0)
+        {
+            FutexWait(&m_count, c);
+        }
     }
 
 private:
-    sem_t m_semaphore;
+    /// 剩余计数
+    std::atomic<int> m_count;
 };
 
 /**
@@ -461,6 +635,137 @@ private:
     pthread_spinlock_t m_mutex;
 };
 
+/**
+ * @brief 自适应的futex互斥锁
+ * @details 先自旋(指数退避，每次退避执行pause)，仍拿不到锁再在futex上睡眠。
+ * 状态：0未加锁，1加锁无等待者，2加锁且可能有等待者；
+ * 无竞争时加锁解锁都只有一次原子操作，没有等待者时解锁不进入内核
+ * @tparam Stats 是否统计竞争次数，关闭时不产生任何额外开销
+ */
+template <bool Stats>
+class FutexMutexImpl : Noncopyable
+{
+public:
+    /// 局部锁
+    typedef ScopedLockImpl<FutexMutexImpl> Lock;
+
+    /// 自旋阶段最多退避的轮数，每轮pause次数翻倍
+    static const int kSpinRounds = 7;
+
+    /**
+     * @brief 构造函数
+     */
+    FutexMutexImpl() {}
+
+    /**
+     * @brief 析构函数
+     */
+    ~FutexMutexImpl() {}
+
+    /**
+     * @brief 加锁
+     */
+    void lock()
+    {
+        int c = 0;
+        if (m_state.compare_exchange_strong(c, 1, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            return;
+        }
+        lockSlow();
+    }
+
+    /**
+     * @brief 尝试加锁
+     */
+    bool tryLock()
+    {
+        int c = 0;
+        return m_state.compare_exchange_strong(c, 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 解锁
+     */
+    void unlock()
+    {
+        if (m_state.exchange(0, std::memory_order_release) == 2)
+        {
+            FutexWake(&m_state, 1);
+        }
+    }
+
+    /**
+     * @brief 发生竞争的加锁次数
+     */
+    uint64_t getContended() const { return m_contended.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 自旋阶段拿到锁的次数
+     */
+    uint64_t getSpinAcquired() const { return m_spinAcquired.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 进入futex睡眠的次数
+     */
+    uint64_t getFutexWaits() const { return m_futexWaits.load(std::memory_order_relaxed); }
+
+private:
+    void lockSlow()
+    {
+        if (Stats)
+        {
+            m_contended.fetch_add(1, std::memory_order_relaxed);
+        }
+        // 自旋阶段，只读等待锁释放，避免反复写导致缓存行来回迁移
+        for (int round = 0; round < kSpinRounds; round++)
+        {
+            for (int i = 0; i < (1 << round); i++)
+            {
+                CpuRelax();
+            }
+            int c = m_state.load(std::memory_order_relaxed);
+            if (c == 0 && m_state.compare_exchange_weak(c, 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                if (Stats)
+                {
+                    m_spinAcquired.fetch_add(1, std::memory_order_relaxed);
+                }
+                return;
+            }
+            if (c == 2)
+            {
+                // 已经有线程在睡眠，继续自旋意义不大
+                break;
+            }
+        }
+        // 睡眠阶段，置为2表示有等待者，解锁方需要唤醒
+        while (m_state.exchange(2, std::memory_order_acquire) != 0)
+        {
+            if (Stats)
+            {
+                m_futexWaits.fetch_add(1, std::memory_order_relaxed);
+            }
+            FutexWait(&m_state, 2);
+        }
+    }
+
+private:
+    /// 锁状态
+    std::atomic<int> m_state{0};
+    /// 发生竞争的加锁次数
+    std::atomic<uint64_t> m_contended{0};
+    /// 自旋阶段拿到锁的次数
+    std::atomic<uint64_t> m_spinAcquired{0};
+    /// 进入futex睡眠的次数
+    std::atomic<uint64_t> m_futexWaits{0};
+};
+
+/// futex互斥锁
+typedef FutexMutexImpl<false> FutexMutex;
+/// 带竞争统计的futex互斥锁
+typedef FutexMutexImpl<true> StatsFutexMutex;
+
 /**
  * @brief 原子锁
  */
@@ -507,4 +812,211 @@ private:
     volatile std::atomic_flag m_mutex;
 };
 
-#endif
\ No newline at end of file
+/**
+ * @brief 缓存行大小
+ */
+static const size_t kCacheLineSize = 64;
+
+/**
+ * @brief 公平的自旋锁等待太久时让出CPU，避免持锁线程被抢占后所有人空转一个时间片
+ */
+static const int kSpinBeforeYield = 1024;
+
+/**
+ * @brief 排号自旋锁
+ * @details 按到达顺序先来先得，加锁只有一次fetch_add；
+ * 等待时按前面排队的人数做比例退避，减少对m_serving缓存行的争抢
+ */
+class TicketLock : Noncopyable
+{
+public:
+    /// 局部锁
+    typedef ScopedLockImpl<TicketLock> Lock;
+
+    /**
+     * @brief 构造函数
+     */
+    TicketLock() {}
+
+    /**
+     * @brief 析构函数
+     */
+    ~TicketLock() {}
+
+    /**
+     * @brief 上锁
+     */
+    void lock()
+    {
+        uint32_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+        int spins = 0;
+        while (true)
+        {
+            uint32_t serving = m_serving.load(std::memory_order_acquire);
+            if (serving == ticket)
+            {
+                return;
+            }
+            for (uint32_t i = 0; i < ticket - serving; i++)
+            {
+                CpuRelax();
+            }
+            if (++spins >= kSpinBeforeYield)
+            {
+                spins = 0;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /**
+     * @brief 解锁
+     */
+    void unlock()
+    {
+        m_serving.store(m_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    /// 下一个要发出的号
+    alignas(kCacheLineSize) std::atomic<uint32_t> m_next{0};
+    /// 当前持锁的号，与m_next分属不同的缓存行
+    alignas(kCacheLineSize) std::atomic<uint32_t> m_serving{0};
+};
+
+/**
+ * @brief MCS队列锁的排队节点，独占一个缓存行，每个等待者只在自己的节点上自旋
+ */
+struct alignas(kCacheLineSize) MCSNode
+{
+    /// 队列中的后继节点
+    std::atomic<MCSNode *> next{nullptr};
+    /// 是否仍需等待
+    std::atomic<bool> locked{false};
+};
+
+/**
+ * @brief MCS排队锁
+ * @details 先来先得，等待者在各自的节点上自旋，释放锁只写后继者的缓存行，
+ * 高竞争下没有缓存行来回迁移。节点从线程局部的节点池中取得，
+ * 对外保持与其他锁一样的lock()/unlock()接口
+ */
+class MCSLock : Noncopyable
+{
+public:
+    /// 局部锁
+    typedef ScopedLockImpl<MCSLock> Lock;
+
+    /**
+     * @brief 构造函数
+     */
+    MCSLock() {}
+
+    /**
+     * @brief 析构函数
+     */
+    ~MCSLock() {}
+
+    /**
+     * @brief 上锁
+     */
+    void lock()
+    {
+        MCSNode *node = AllocNode();
+        node->next.store(nullptr, std::memory_order_relaxed);
+        node->locked.store(true, std::memory_order_relaxed);
+        MCSNode *prev = m_tail.exchange(node, std::memory_order_acq_rel);
+        if (prev)
+        {
+            prev->next.store(node, std::memory_order_release);
+            int spins = 0;
+            while (node->locked.load(std::memory_order_acquire))
+            {
+                CpuRelax();
+                if (++spins >= kSpinBeforeYield)
+                {
+                    spins = 0;
+                    std::this_thread::yield();
+                }
+            }
+        }
+        m_owner = node;
+    }
+
+    /**
+     * @brief 解锁
+     */
+    void unlock()
+    {
+        MCSNode *node = m_owner;
+        MCSNode *next = node->next.load(std::memory_order_acquire);
+        if (!next)
+        {
+            MCSNode *expected = node;
+            if (m_tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+            {
+                FreeNode(node);
+                return;
+            }
+            // 后继者已经进入队列但还没来得及链接上
+            while (!(next = node->next.load(std::memory_order_acquire)))
+            {
+                CpuRelax();
+            }
+        }
+        next->locked.store(false, std::memory_order_release);
+        FreeNode(node);
+    }
+
+private:
+    /**
+     * @brief 线程局部的空闲节点池
+     */
+    struct NodePool
+    {
+        MCSNode *head = nullptr;
+
+        ~NodePool()
+        {
+            while (head)
+            {
+                MCSNode *next = head->next.load(std::memory_order_relaxed);
+                delete head;
+                head = next;
+            }
+        }
+    };
+
+    static NodePool &Pool()
+    {
+        static thread_local NodePool pool;
+        return pool;
+    }
+
+    static MCSNode *AllocNode()
+    {
+        NodePool &pool = Pool();
+        if (pool.head)
+        {
+            MCSNode *node = pool.head;
+            pool.head = node->next.load(std::memory_order_relaxed);
+            return node;
+        }
+        return new MCSNode;
+    }
+
+    static void FreeNode(MCSNode *node)
+    {
+        NodePool &pool = Pool();
+        node->next.store(pool.head, std::memory_order_relaxed);
+        pool.head = node;
+    }
+
+private:
+    /// 队尾节点
+    alignas(kCacheLineSize) std::atomic<MCSNode *> m_tail{nullptr};
+    /// 持锁者的节点，只有持锁者读写
+    MCSNode *m_owner = nullptr;
+};
+
+#endif
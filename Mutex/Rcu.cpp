@@ -0,0 +1,238 @@
+#include "Rcu.h"
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <assert.h>
+
+// QSBR线程每报告这么多次静止状态，尝试执行一次延迟回调
+static const uint32_t kReclaimInterval = 64;
+
+namespace
+{
+    /**
+     * @brief 每个线程的读者状态，独占一个缓存行
+     * @details epoch为0表示线程不在读临界区(离线)，否则为该线程最近看到的全局epoch
+     */
+    struct alignas(kCacheLineSize) ThreadRecord
+    {
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    /**
+     * @brief 延迟回调
+     */
+    struct DeferredCallback
+    {
+        // 所有读者的epoch都达到这个值之后才能执行
+        uint64_t epoch;
+        std::function<void()> cb;
+    };
+
+    /**
+     * @brief 全局状态
+     */
+    struct RcuState
+    {
+        // 全局epoch，从1开始，0表示离线
+        std::atomic<uint64_t> epoch{1};
+        // 所有线程的读者状态
+        Mutex mutex;
+        std::vector<ThreadRecord *> records;
+        // 延迟回调
+        Mutex deferredMutex;
+        std::vector<DeferredCallback> deferred;
+        std::atomic<size_t> deferredCount{0};
+    };
+
+    RcuState &GetState()
+    {
+        // 故意不析构，线程退出时还可能访问
+        static RcuState *state = new RcuState;
+        return *state;
+    }
+
+    /**
+     * @brief 线程局部状态
+     */
+    struct ThreadState
+    {
+        ThreadRecord *record = nullptr;
+        // 是否QSBR线程
+        bool qsbr = false;
+        // 读临界区嵌套深度(非QSBR线程)
+        int nesting = 0;
+        // 报告静止状态的次数
+        uint32_t quiescentCount = 0;
+
+        ThreadRecord *getRecord()
+        {
+            if (!record)
+            {
+                record = new ThreadRecord;
+                RcuState &state = GetState();
+                Mutex::Lock lock(state.mutex);
+                state.records.push_back(record);
+            }
+            return record;
+        }
+
+        ~ThreadState()
+        {
+            if (record)
+            {
+                RcuState &state = GetState();
+                Mutex::Lock lock(state.mutex);
+                state.records.erase(std::find(state.records.begin(), state.records.end(), record));
+                delete record;
+            }
+        }
+    };
+
+    thread_local ThreadState t_rcu;
+
+    /**
+     * @brief 所有在线读者中最小的epoch，没有在线读者时返回UINT64_MAX
+     * @param[in] self_quiescent 调用者自己是否处于静止状态，是则不考虑自己的记录
+     */
+    uint64_t MinOnlineEpoch(bool self_quiescent)
+    {
+        RcuState &state = GetState();
+        uint64_t min_epoch = UINT64_MAX;
+        Mutex::Lock lock(state.mutex);
+        for (auto record : state.records)
+        {
+            if (record == t_rcu.record && self_quiescent)
+            {
+                continue;
+            }
+            uint64_t epoch = record->epoch.load(std::memory_order_seq_cst);
+            if (epoch)
+            {
+                min_epoch = std::min(min_epoch, epoch);
+            }
+        }
+        return min_epoch;
+    }
+}
+
+void Rcu::RegisterThread()
+{
+    ThreadRecord *record = t_rcu.getRecord();
+    t_rcu.qsbr = true;
+    record->epoch.store(GetState().epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+}
+
+void Rcu::UnregisterThread()
+{
+    if (!t_rcu.qsbr)
+    {
+        return;
+    }
+    t_rcu.qsbr = false;
+    t_rcu.record->epoch.store(0, std::memory_order_release);
+}
+
+void Rcu::Quiescent()
+{
+    if (!t_rcu.qsbr)
+    {
+        return;
+    }
+    // acquire与写者推进epoch配对，之后的读一定能看到写者发布的新对象
+    uint64_t epoch = GetState().epoch.load(std::memory_order_acquire);
+    // epoch没变就不写，避免无谓地弄脏缓存行
+    if (t_rcu.record->epoch.load(std::memory_order_relaxed) != epoch)
+    {
+        t_rcu.record->epoch.store(epoch, std::memory_order_release);
+    }
+    if (++t_rcu.quiescentCount % kReclaimInterval == 0 && GetState().deferredCount)
+    {
+        Reclaim(true);
+    }
+}
+
+void Rcu::ReadLock()
+{
+    if (t_rcu.qsbr)
+    {
+        return;
+    }
+    if (t_rcu.nesting++ == 0)
+    {
+        // 非QSBR线程在进入读临界区时上线，seq_cst保证写者扫描时能看到
+        t_rcu.getRecord()->epoch.store(GetState().epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    }
+}
+
+void Rcu::ReadUnlock()
+{
+    if (t_rcu.qsbr)
+    {
+        return;
+    }
+    if (--t_rcu.nesting == 0)
+    {
+        t_rcu.record->epoch.store(0, std::memory_order_release);
+    }
+}
+
+void Rcu::Synchronize()
+{
+    assert(t_rcu.nesting == 0);
+    uint64_t target = GetState().epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    if (t_rcu.qsbr)
+    {
+        t_rcu.record->epoch.store(target, std::memory_order_release);
+    }
+    while (MinOnlineEpoch(true) < target)
+    {
+        usleep(10);
+    }
+}
+
+void Rcu::Defer(std::function<void()> cb)
+{
+    RcuState &state = GetState();
+    uint64_t target = state.epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    {
+        Mutex::Lock lock(state.deferredMutex);
+        state.deferred.push_back(DeferredCallback{target, std::move(cb)});
+    }
+    // 没有QSBR线程时也要让回调有机会执行，积压到一定数量就尝试回收
+    if (++state.deferredCount % kReclaimInterval == 0)
+    {
+        // 调用者可能还在使用刚替换下来的对象，不能把自己当作静止状态
+        Reclaim(false);
+    }
+}
+
+void Rcu::Reclaim(bool self_quiescent)
+{
+    RcuState &state = GetState();
+    uint64_t safe = MinOnlineEpoch(self_quiescent);
+    std::vector<DeferredCallback> ready;
+    {
+        Mutex::Lock lock(state.deferredMutex);
+        auto it = std::stable_partition(state.deferred.begin(), state.deferred.end(),
+                                        [safe](const DeferredCallback &i) { return i.epoch > safe; });
+        std::move(it, state.deferred.end(), std::back_inserter(ready));
+        state.deferred.erase(it, state.deferred.end());
+        state.deferredCount -= ready.size();
+    }
+    // 回调在锁外执行，回调中可以再次Defer
+    for (auto &i : ready)
+    {
+        i.cb();
+    }
+}
+
+void Rcu::Barrier()
+{
+    Synchronize();
+    Reclaim(true);
+}
+
+size_t Rcu::PendingCallbacks()
+{
+    return GetState().deferredCount;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file Rcu.h
+ * @brief 基于epoch的RCU
+ * @details 读多写少的共享数据(配置、路由表)用RcuPtr发布，写者替换指针后，
+ * 旧对象要等所有读者都经过一次静止状态(quiescent state)才能释放。
+ * 调度器的工作线程每轮调度循环自动报告一次静止状态(QSBR)，读者加读锁没有任何开销；
+ * 其他线程的读锁退化为写自己缓存行上的epoch，同样不会在读者之间产生竞争。
+ * @attention 协程会在工作线程间迁移，读临界区内不能yield
+ */
+#ifndef __RCU_H__
+#define __RCU_H__
+
+#include "Mutex.h"
+
+class Rcu
+{
+public:
+    /**
+     * @brief 把当前线程注册为QSBR线程，之后必须周期性调用Quiescent()
+     * @details 调度器的工作线程在进入调度循环时自动注册
+     */
+    static void RegisterThread();
+
+    /**
+     * @brief 注销当前QSBR线程，之后不再阻塞写者
+     */
+    static void UnregisterThread();
+
+    /**
+     * @brief 报告当前线程处于静止状态，即不在任何读临界区内
+     */
+    static void Quiescent();
+
+    /**
+     * @brief 进入读临界区
+     */
+    static void ReadLock();
+
+    /**
+     * @brief 退出读临界区
+     */
+    static void ReadUnlock();
+
+    /**
+     * @brief 等待一个宽限期，返回时之前开始的读临界区都已经结束
+     * @attention 不能在读临界区内调用
+     */
+    static void Synchronize();
+
+    /**
+     * @brief 宽限期结束后执行cb，不阻塞调用者
+     * @details 回调在某个线程报告静止状态时或Barrier()中执行
+     */
+    static void Defer(std::function<void()> cb);
+
+    /**
+     * @brief 等待一个宽限期并执行所有已到期的延迟回调
+     */
+    static void Barrier();
+
+    /**
+     * @brief 等待执行的延迟回调数量
+     */
+    static size_t PendingCallbacks();
+
+private:
+    /**
+     * @brief 执行已经安全的延迟回调
+     * @param[in] self_quiescent 调用者自己是否处于静止状态
+     */
+    static void Reclaim(bool self_quiescent);
+};
+
+/**
+ * @brief 进入读临界区，在调度器工作线程上是空操作
+ */
+inline void rcu_read_lock()
+{
+    Rcu::ReadLock();
+}
+
+/**
+ * @brief 退出读临界区
+ */
+inline void rcu_read_unlock()
+{
+    Rcu::ReadUnlock();
+}
+
+/**
+ * @brief 局部读锁
+ */
+struct RcuReadLock : Noncopyable
+{
+    RcuReadLock() { rcu_read_lock(); }
+    ~RcuReadLock() { rcu_read_unlock(); }
+};
+
+/**
+ * @brief RCU保护的指针
+ */
+template <class T>
+class RcuPtr : Noncopyable
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] value 初始对象，由new分配
+     */
+    explicit RcuPtr(T *value = nullptr) : m_ptr(value) {}
+
+    /**
+     * @brief 析构函数，此时不能再有读者
+     */
+    ~RcuPtr()
+    {
+        delete m_ptr.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 在读临界区内读取当前对象
+     */
+    const T *read() const
+    {
+        return m_ptr.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 发布新对象，旧对象在宽限期后释放
+     * @param[in] value 新对象，由new分配
+     */
+    void update(T *value)
+    {
+        T *old = m_ptr.exchange(value, std::memory_order_acq_rel);
+        if (old)
+        {
+            Rcu::Defer([old]() { delete old; });
+        }
+    }
+
+private:
+    std::atomic<T *> m_ptr;
+};
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file SeqLock.h
+ * @brief 顺序锁
+ * @details 读多写少的小块数据(配置、统计快照等)，读者不写任何共享变量，
+ * 只读两次序号，读到一半被写者打断就重试，读者数量增加不会产生缓存行竞争
+ */
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include "Mutex.h"
+#include <string.h>
+#include <type_traits>
+
+/**
+ * @brief 顺序锁保护的值
+ * @tparam T 必须可以按字节拷贝
+ */
+template <class T>
+class SeqLock : Noncopyable
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type");
+
+    /// 值占用的8字节单元数
+    static const size_t kWords = (sizeof(T) + 7) / 8;
+
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] value 初始值
+     */
+    SeqLock(const T &value = T())
+    {
+        copyIn(&value);
+    }
+
+    /**
+     * @brief 读取一份一致的快照
+     */
+    T load() const
+    {
+        T value;
+        while (true)
+        {
+            uint64_t begin = m_seq.load(std::memory_order_acquire);
+            if (begin & 1)
+            {
+                // 写者正在写
+                CpuRelax();
+                continue;
+            }
+            copyOut(&value);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_seq.load(std::memory_order_relaxed) == begin)
+            {
+                return value;
+            }
+        }
+    }
+
+    /**
+     * @brief 写入新值，写者之间用自旋锁互斥
+     */
+    void store(const T &value)
+    {
+        Spinlock::Lock lock(m_writer);
+        writeLocked(value);
+    }
+
+    /**
+     * @brief 读-改-写
+     * @param[in] f 形如void(T&)的修改函数，在写锁内执行
+     */
+    template <class Func>
+    void update(Func f)
+    {
+        Spinlock::Lock lock(m_writer);
+        T value;
+        copyOut(&value);
+        f(value);
+        writeLocked(value);
+    }
+
+private:
+    void writeLocked(const T &value)
+    {
+        uint64_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        copyIn(&value);
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief 按8字节为单位用relaxed原子读，避免与写者的数据竞争
+     */
+    void copyOut(T *value) const
+    {
+        uint64_t words[kWords];
+        for (size_t i = 0; i < kWords; i++)
+        {
+            words[i] = __atomic_load_n(&m_value[i], __ATOMIC_RELAXED);
+        }
+        memcpy(value, words, sizeof(T));
+    }
+
+    void copyIn(const T *value)
+    {
+        uint64_t words[kWords] = {0};
+        memcpy(words, value, sizeof(T));
+        for (size_t i = 0; i < kWords; i++)
+        {
+            __atomic_store_n(&m_value[i], words[i], __ATOMIC_RELAXED);
+        }
+    }
+
+private:
+    /// 序号，奇数表示正在写
+    alignas(kCacheLineSize) std::atomic<uint64_t> m_seq{0};
+    /// 值，按8字节对齐存放
+    uint64_t m_value[kWords];
+    /// 写者互斥
+    Spinlock m_writer;
+};
+
+#endif
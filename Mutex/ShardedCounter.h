@@ -0,0 +1,160 @@
+/**
+ * @file ShardedCounter.h
+ * @brief 分片计数器和分段ID分配器
+ * @details 高频更新的全局计数如果只用一个原子变量，所有核心都在争抢同一个缓存行。
+ * 分片计数器把计数分散到多个按缓存行对齐的分片上，每个线程固定更新其中一个，
+ * 读的时候再把所有分片加起来；分段ID分配器每次从全局申请一段ID，线程内部顺序发放
+ */
+#ifndef __SHARDED_COUNTER_H__
+#define __SHARDED_COUNTER_H__
+
+#include "Mutex.h"
+#include <time.h>
+
+/**
+ * @brief 分片计数器
+ */
+class ShardedCounter : Noncopyable
+{
+public:
+    /// 分片数量
+    static const size_t kShards = 32;
+    /// 近似值的缓存时间(微秒)
+    static const uint64_t kApproxIntervalUS = 1000;
+
+    /**
+     * @brief 构造函数
+     */
+    ShardedCounter() {}
+
+    /**
+     * @brief 增加n
+     */
+    void add(int64_t n)
+    {
+        m_shards[ShardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 加一
+     */
+    void inc() { add(1); }
+
+    /**
+     * @brief 减一
+     */
+    void dec() { add(-1); }
+
+    /**
+     * @brief 读取所有分片之和
+     * @details 读的过程中没有并发更新时是精确值，代价是读kShards个缓存行
+     */
+    int64_t load() const
+    {
+        int64_t sum = 0;
+        for (size_t i = 0; i < kShards; i++)
+        {
+            sum += m_shards[i].value.load(std::memory_order_acquire);
+        }
+        return sum;
+    }
+
+    /**
+     * @brief 读取近似值，最多落后kApproxIntervalUS，适合频繁读取的监控场景
+     */
+    int64_t approx() const
+    {
+        uint64_t now = NowUS();
+        if (now - m_cachedAt.load(std::memory_order_relaxed) >= kApproxIntervalUS)
+        {
+            m_cached.store(load(), std::memory_order_relaxed);
+            m_cachedAt.store(now, std::memory_order_relaxed);
+        }
+        return m_cached.load(std::memory_order_relaxed);
+    }
+
+private:
+    /**
+     * @brief 单个分片，独占一个缓存行
+     */
+    struct alignas(kCacheLineSize) Shard
+    {
+        std::atomic<int64_t> value{0};
+    };
+
+    /**
+     * @brief 当前线程使用的分片，线程第一次使用时轮流分配
+     */
+    static size_t ShardIndex()
+    {
+        static std::atomic<size_t> s_next{0};
+        static thread_local size_t t_index = s_next++ % kShards;
+        return t_index;
+    }
+
+    static uint64_t NowUS()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+    }
+
+private:
+    /// 分片
+    Shard m_shards[kShards];
+    /// 缓存的近似值
+    mutable std::atomic<int64_t> m_cached{0};
+    /// 近似值的缓存时间
+    mutable std::atomic<uint64_t> m_cachedAt{0};
+};
+
+/**
+ * @brief 只有一个线程更新的计数器
+ * @details 接口与ShardedCounter相同。更新是普通的读、加、写，没有原子的读改写指令，
+ * 其他线程读到的是某个较新的值；单线程的调度器用它代替ShardedCounter
+ */
+class LocalCounter : Noncopyable
+{
+public:
+    void add(int64_t n) { m_value.store(m_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void inc() { add(1); }
+    void dec() { add(-1); }
+    int64_t load() const { return m_value.load(std::memory_order_relaxed); }
+    int64_t approx() const { return load(); }
+
+private:
+    std::atomic<int64_t> m_value{0};
+};
+
+/**
+ * @brief 分段ID分配器
+ * @details 每个线程一次从全局申请BlockSize个连续ID，用完再申请，
+ * 全局原子变量的更新频率降低为1/BlockSize；ID全局唯一，但不再按分配时间严格递增
+ * @tparam Tag 区分不同的ID空间
+ * @tparam BlockSize 每次申请的ID数量
+ */
+template <class Tag, uint64_t BlockSize = 1024>
+class IdBlockAllocator
+{
+public:
+    /**
+     * @brief 分配一个ID
+     */
+    static uint64_t Next()
+    {
+        static thread_local uint64_t t_next = 0;
+        static thread_local uint64_t t_end = 0;
+        if (t_next == t_end)
+        {
+            t_next = s_next.fetch_add(BlockSize, std::memory_order_relaxed);
+            t_end = t_next + BlockSize;
+        }
+        return t_next++;
+    }
+
+private:
+    /// 下一段ID的起始值
+    static inline std::atomic<uint64_t> s_next{0};
+};
+
+#endif
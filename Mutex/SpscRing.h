@@ -0,0 +1,110 @@
+/**
+ * @file SpscRing.h
+ * @brief 单生产者单消费者无锁环形队列
+ */
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include "Mutex.h"
+#include <vector>
+
+/**
+ * @brief 单生产者单消费者无锁环形队列
+ * @details 生产者只写m_tail，消费者只写m_head，两者分属不同的缓存行；
+ * 双方各自缓存对方的位置，只有缓存的值显示队列满/空时才去读对方的缓存行
+ * @tparam T 元素类型
+ */
+template <class T>
+class SpscRing : Noncopyable
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] capacity 容量，向上取整为2的幂
+     */
+    explicit SpscRing(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_buffer.resize(size);
+    }
+
+    /**
+     * @brief 入队，只能由生产者调用
+     * @return 队列已满时返回false
+     */
+    template <class U>
+    bool push(U &&value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache > m_mask)
+        {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache > m_mask)
+            {
+                return false;
+            }
+        }
+        m_buffer[tail & m_mask] = std::forward<U>(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 出队，只能由消费者调用
+     * @return 队列为空时返回false
+     */
+    bool pop(T &value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache)
+        {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache)
+            {
+                return false;
+            }
+        }
+        value = std::move(m_buffer[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 当前元素数量的近似值，任何线程都可以调用
+     */
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 是否为空的近似判断，任何线程都可以调用
+     */
+    bool empty() const { return size() == 0; }
+
+    /**
+     * @brief 容量
+     */
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    /// 元素存储
+    std::vector<T> m_buffer;
+    /// 容量-1
+    size_t m_mask;
+    /// 消费者位置，只由消费者写
+    alignas(kCacheLineSize) std::atomic<size_t> m_head{0};
+    /// 消费者缓存的生产者位置
+    size_t m_tailCache = 0;
+    /// 生产者位置，只由生产者写
+    alignas(kCacheLineSize) std::atomic<size_t> m_tail{0};
+    /// 生产者缓存的消费者位置
+    size_t m_headCache = 0;
+};
+
+#endif
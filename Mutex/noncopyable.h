@@ -6,7 +6,8 @@
  * @date 2019-05-31
  * @copyright Copyright (c) 2019年 sylar.yin All rights reserved (www.sylar.top)
  */
-
+#ifndef __NONCOPYABLE_H__
+#define __NONCOPYABLE_H__
 
 /**
  * @brief 对象无法拷贝,赋值
@@ -34,3 +35,4 @@ public:
     Noncopyable& operator=(const Noncopyable&) = delete;
 };
 
+#endif
@@ -0,0 +1,143 @@
+#include "BlockingPool.h"
+#include "../Mutex/LockProfiler.h"
+#include "../Log/Log.h"
+
+BlockingPool::BlockingPool(size_t max_threads, uint64_t keepalive_ms, const std::string &name)
+    : m_maxThreads(max_threads ? max_threads : 1), m_keepaliveMS(keepalive_ms), m_name(name)
+{
+}
+
+BlockingPool::~BlockingPool()
+{
+    std::vector<Thread::ptr> thrs;
+    {
+        SCOPED_LOCK(MutexType, lock, m_mutex);
+        m_stopping = true;
+        // 叫醒所有空闲线程，它们看到任务队列为空就退出
+        for (; m_idle > 0; --m_idle)
+        {
+            m_sem.notify();
+        }
+    }
+    // 线程退出时会把自己移到m_retired，直到两个列表都空为止
+    while (true)
+    {
+        {
+            SCOPED_LOCK(MutexType, lock, m_mutex);
+            thrs.swap(m_threads);
+            thrs.insert(thrs.end(), m_retired.begin(), m_retired.end());
+            m_retired.clear();
+        }
+        if (thrs.empty())
+        {
+            break;
+        }
+        for (auto &i : thrs)
+        {
+            i->join();
+        }
+        thrs.clear();
+    }
+}
+
+BlockingPool &BlockingPool::Get()
+{
+    // 不析构，进程退出时可能还有协程在等阻塞调用
+    static BlockingPool *s_pool = new BlockingPool;
+    return *s_pool;
+}
+
+void BlockingPool::submit(std::function<void()> job)
+{
+    std::vector<Thread::ptr> retired;
+    {
+        SCOPED_LOCK(MutexType, lock, m_mutex);
+        m_jobs.push_back(std::move(job));
+        if (m_idle > 0)
+        {
+            // 令牌在锁内发出，超时的线程持锁检查令牌时不会漏掉
+            --m_idle;
+            m_sem.notify();
+        }
+        else if (m_threads.size() < m_maxThreads)
+        {
+            retired.swap(m_retired);
+            uint64_t n = m_spawned++;
+            m_threads.push_back(Thread::ptr(new Thread(std::bind(&BlockingPool::run, this),
+                                                       m_name + '_' + std::to_string(n), ThreadAttr(), false)));
+        }
+        // 线程都在忙且到了上限，任务排队等某个线程做完手上的
+    }
+    for (auto &i : retired)
+    {
+        i->join();
+    }
+}
+
+void BlockingPool::setMaxThreads(size_t max_threads)
+{
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+    m_maxThreads = max_threads ? max_threads : 1;
+}
+
+size_t BlockingPool::getThreadCount()
+{
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+    return m_threads.size();
+}
+
+size_t BlockingPool::getIdleCount()
+{
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+    return m_idle;
+}
+
+void BlockingPool::run()
+{
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+    while (true)
+    {
+        if (!m_jobs.empty())
+        {
+            std::function<void()> job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            lock.unlock();
+            job();
+            job = nullptr;
+            ++m_jobCount;
+            lock.lock();
+            continue;
+        }
+        if (m_stopping)
+        {
+            break;
+        }
+        ++m_idle;
+        lock.unlock();
+        bool woken = m_sem.waitFor(m_keepaliveMS * 1000);
+        lock.lock();
+        if (!woken && !m_sem.tryWait())
+        {
+            // 超时且没有令牌，m_idle里还算着自己
+            --m_idle;
+            if (m_jobs.empty())
+            {
+                break;
+            }
+        }
+    }
+    retireThread();
+}
+
+void BlockingPool::retireThread()
+{
+    for (auto it = m_threads.begin(); it != m_threads.end(); ++it)
+    {
+        if (it->get() == Thread::GetThis())
+        {
+            m_retired.push_back(*it);
+            m_threads.erase(it);
+            return;
+        }
+    }
+}
@@ -0,0 +1,105 @@
+/**
+ * @file BlockingPool.h
+ * @brief 执行阻塞调用的弹性线程池
+ * @details 没法改造成非阻塞的库(文件系统、压缩、老的数据库客户端)的调用交给这里的线程执行，
+ * 调度器的工作线程不会因此被占住。线程按需创建，没有空闲线程且没到上限时每提交一个任务创建一个，
+ * 空闲超过keepalive_ms的线程自动退出。协程通过Scheduler::blocking()使用，见Scheduler.h
+ */
+#ifndef __BLOCKING_POOL_H__
+#define __BLOCKING_POOL_H__
+
+#include "../Mutex/Mutex.h"
+#include "../Thread/Threads.h"
+#include <atomic>
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 阻塞调用线程池
+ */
+class BlockingPool : Noncopyable
+{
+public:
+    typedef FutexMutex MutexType;
+
+    /**
+     * @brief 构造函数，不会创建线程
+     * @param[in] max_threads 最多同时存在的线程数
+     * @param[in] keepalive_ms 线程空闲多久后退出(毫秒)
+     * @param[in] name 线程名前缀
+     */
+    BlockingPool(size_t max_threads = 64, uint64_t keepalive_ms = 10000, const std::string &name = "blocking");
+
+    /**
+     * @brief 析构函数，执行完所有已经提交的任务，等所有线程退出
+     */
+    ~BlockingPool();
+
+    /**
+     * @brief 进程共享的线程池，Scheduler::blocking()使用
+     */
+    static BlockingPool &Get();
+
+    /**
+     * @brief 提交一个任务
+     */
+    void submit(std::function<void()> job);
+
+    /**
+     * @brief 设置最多同时存在的线程数，只影响之后创建线程
+     */
+    void setMaxThreads(size_t max_threads);
+
+    /**
+     * @brief 当前存活的线程数
+     */
+    size_t getThreadCount();
+
+    /**
+     * @brief 当前空闲的线程数
+     */
+    size_t getIdleCount();
+
+    /**
+     * @brief 创建过的线程总数
+     */
+    uint64_t getSpawnedCount() const { return m_spawned.load(); }
+
+    /**
+     * @brief 执行完的任务总数
+     */
+    uint64_t getJobCount() const { return m_jobCount.load(); }
+
+private:
+    /**
+     * @brief 线程主函数
+     */
+    void run();
+
+    /**
+     * @brief 线程退出前把自己的Thread对象移到待join列表，调用时持有m_mutex
+     */
+    void retireThread();
+
+private:
+    MutexType m_mutex;
+    // 等待执行的任务
+    std::list<std::function<void()>> m_jobs;
+    // 空闲线程在这里等待，每个令牌唤醒一个已经从m_idle中扣掉的线程
+    Semaphore m_sem;
+    // 存活的线程和已经退出等待join的线程
+    std::vector<Thread::ptr> m_threads;
+    std::vector<Thread::ptr> m_retired;
+    // 空闲且还没有被分配令牌的线程数
+    size_t m_idle = 0;
+    size_t m_maxThreads;
+    uint64_t m_keepaliveMS;
+    std::string m_name;
+    bool m_stopping = false;
+    std::atomic<uint64_t> m_spawned = {0};
+    std::atomic<uint64_t> m_jobCount = {0};
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "Parallel.h"
+#include <sched.h>
+
+ForkJoin::ForkJoin(SchedulerBase *scheduler, size_t grain, const Body &body, size_t total)
+    : m_scheduler(scheduler), m_grain(grain), m_body(&body), m_remaining(total)
+{
+    // 发起者自己也执行区间，帮手数不超过工作线程数
+    m_maxHelpers = std::max<size_t>(1, scheduler->getThreadCount());
+}
+
+size_t ForkJoin::DefaultGrain(SchedulerBase *scheduler, size_t n)
+{
+    size_t workers = scheduler ? scheduler->getThreadCount() + 1 : 1;
+    return std::max<size_t>(1, n / (workers * 8));
+}
+
+void ForkJoin::Run(SchedulerBase *scheduler, size_t begin, size_t end, size_t grain, const Body &body)
+{
+    grain = std::max<size_t>(1, grain);
+    if (!scheduler || end - begin <= grain)
+    {
+        body(begin, end);
+        return;
+    }
+    ForkJoin::ptr job(new ForkJoin(scheduler, grain, body, end - begin));
+    job->m_ranges.emplace_back(begin, end);
+    job->join();
+    if (job->m_error)
+    {
+        std::rethrow_exception(job->m_error);
+    }
+}
+
+bool ForkJoin::runOne()
+{
+    size_t lo, hi;
+    {
+        Spinlock::Lock lock(m_lock);
+        if (m_ranges.empty())
+        {
+            return false;
+        }
+        lo = m_ranges.front().first;
+        hi = m_ranges.front().second;
+        m_ranges.pop_front();
+    }
+    // 右半部分留给其他线程偷取，自己继续拆分左半部分
+    while (hi - lo > m_grain)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        fork(mid, hi);
+        hi = mid;
+    }
+    try
+    {
+        (*m_body)(lo, hi);
+    }
+    catch (...)
+    {
+        Spinlock::Lock lock(m_lock);
+        if (!m_error)
+        {
+            m_error = std::current_exception();
+        }
+    }
+    // 最后一个区间执行完后发起者可能马上返回，之后不能再访问m_body
+    m_remaining.fetch_sub(hi - lo, std::memory_order_acq_rel);
+    return true;
+}
+
+void ForkJoin::fork(size_t lo, size_t hi)
+{
+    {
+        Spinlock::Lock lock(m_lock);
+        m_ranges.emplace_back(lo, hi);
+    }
+    if (m_helpers.load(std::memory_order_relaxed) < m_maxHelpers)
+    {
+        ++m_helpers;
+        // 帮手可能在发起者返回之后才被调度，持有共享状态
+        ForkJoin::ptr self = shared_from_this();
+        m_scheduler->scheduleFunction([self]() { self->help(); }, -1);
+    }
+}
+
+void ForkJoin::help()
+{
+    while (runOne())
+    {
+    }
+    --m_helpers;
+}
+
+void ForkJoin::join()
+{
+    while (m_remaining.load(std::memory_order_acquire))
+    {
+        if (runOne())
+        {
+            continue;
+        }
+        // 剩下的区间都在其他线程上执行，在调度器的有栈协程中就让出，让当前工作线程去执行别的任务
+        if (Coroutine *co = SchedulerBase::GetTaskCoroutine())
+        {
+            co->reschedule();
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
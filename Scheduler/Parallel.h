@@ -0,0 +1,224 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+/**
+ * @brief 基于Scheduler的fork-join并行算法
+ * @details parallel_for/parallel_reduce/parallel_transform/parallel_sort使用调度器已有的工作线程，不额外创建线程。
+ * 区间按二分递归拆分：执行者每次把右半部分放入共享的区间队列，继续拆分左半部分，直到不大于粒度后执行；
+ * 拆出的区间由调度到工作线程上的帮手任务从队首偷取，队首总是最早拆出的、最大的区间。
+ * 发起调用的线程(或协程)同样从区间队列取任务执行，取完后等待其他线程上的区间结束：
+ * 在调度器的有栈协程中等待时让出，让工作线程先执行其他任务，否则sched_yield。
+ * 没有调度器或者区间不大于粒度时直接在当前线程串行执行
+ */
+#include "Scheduler.h"
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 一次fork-join调用的共享状态
+ */
+class ForkJoin : public std::enable_shared_from_this<ForkJoin>, Noncopyable
+{
+public:
+    typedef std::shared_ptr<ForkJoin> ptr;
+    /// 处理区间[lo, hi)
+    typedef std::function<void(size_t, size_t)> Body;
+
+    /**
+     * @brief 并行处理区间[begin, end)，所有区间执行完才返回
+     * @details body抛出的第一个异常在返回前重新抛出，其余区间仍然会执行
+     * @param[in] scheduler 执行区间的调度器，nullptr为串行执行
+     * @param[in] begin 区间起点
+     * @param[in] end 区间终点(不包含)
+     * @param[in] grain 不再拆分的区间长度
+     * @param[in] body 区间处理函数
+     */
+    static void Run(SchedulerBase *scheduler, size_t begin, size_t end, size_t grain, const Body &body);
+
+    /**
+     * @brief 没有指定粒度时使用的粒度，每个工作线程平均分到8个区间
+     * @param[in] scheduler 调度器
+     * @param[in] n 区间长度
+     */
+    static size_t DefaultGrain(SchedulerBase *scheduler, size_t n);
+
+private:
+    ForkJoin(SchedulerBase *scheduler, size_t grain, const Body &body, size_t total);
+
+    /**
+     * @brief 从区间队列取一个区间，拆分到粒度后执行
+     * @return 区间队列为空时返回false
+     */
+    bool runOne();
+
+    /**
+     * @brief 把拆出的区间放入区间队列，帮手不够时再调度一个帮手任务
+     */
+    void fork(size_t lo, size_t hi);
+
+    /**
+     * @brief 帮手任务：取区间执行直到区间队列为空
+     */
+    void help();
+
+    /**
+     * @brief 发起者等待所有区间执行完
+     */
+    void join();
+
+private:
+    SchedulerBase *m_scheduler;
+    size_t m_grain;
+    // 发起者的区间处理函数，发起者返回之前一直有效，帮手只在取到区间时访问
+    const Body *m_body;
+    // 保护区间队列和异常
+    Spinlock m_lock;
+    // 已经拆出、还没有执行者的区间
+    std::deque<std::pair<size_t, size_t>> m_ranges;
+    // 还没有执行完的元素数
+    std::atomic<size_t> m_remaining;
+    // 已经调度、还没有退出的帮手任务数，不超过m_maxHelpers
+    std::atomic<size_t> m_helpers = {0};
+    size_t m_maxHelpers;
+    // body抛出的第一个异常
+    std::exception_ptr m_error;
+};
+
+/**
+ * @brief 并行执行f(i)，i取遍[begin, end)
+ * @param[in] begin 起始下标
+ * @param[in] end 结束下标(不包含)
+ * @param[in] grain 一个任务至少处理的下标数
+ * @param[in] f 处理一个下标的函数
+ * @param[in] scheduler 调度器，默认为当前线程的调度器
+ */
+template <class F>
+void parallel_for(size_t begin, size_t end, size_t grain, F f, SchedulerBase *scheduler = SchedulerBase::GetThis())
+{
+    if (end <= begin)
+    {
+        return;
+    }
+    ForkJoin::Run(scheduler, begin, end, grain, [&f](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++)
+        {
+            f(i);
+        }
+    });
+}
+
+/**
+ * @brief 并行归约：combine(...combine(combine(identity, f(begin)), f(begin + 1))..., f(end - 1))
+ * @details 每个区间先归约出部分结果，最后按区间顺序合并，combine只需要满足结合律，不需要交换律
+ * @param[in] begin 起始下标
+ * @param[in] end 结束下标(不包含)
+ * @param[in] grain 一个任务至少处理的下标数
+ * @param[in] identity combine的单位元
+ * @param[in] f 把下标映射为值的函数
+ * @param[in] combine 合并两个值的函数
+ * @param[in] scheduler 调度器，默认为当前线程的调度器
+ */
+template <class T, class F, class C>
+T parallel_reduce(size_t begin, size_t end, size_t grain, T identity, F f, C combine,
+                  SchedulerBase *scheduler = SchedulerBase::GetThis())
+{
+    if (end <= begin)
+    {
+        return identity;
+    }
+    Spinlock lock;
+    std::vector<std::pair<size_t, T>> partials;
+    ForkJoin::Run(scheduler, begin, end, grain, [&](size_t lo, size_t hi) {
+        T acc = identity;
+        for (size_t i = lo; i < hi; i++)
+        {
+            acc = combine(std::move(acc), f(i));
+        }
+        Spinlock::Lock guard(lock);
+        partials.emplace_back(lo, std::move(acc));
+    });
+    std::sort(partials.begin(), partials.end(),
+              [](const std::pair<size_t, T> &a, const std::pair<size_t, T> &b) { return a.first < b.first; });
+    T result = std::move(identity);
+    for (auto &i : partials)
+    {
+        result = combine(std::move(result), std::move(i.second));
+    }
+    return result;
+}
+
+/**
+ * @brief 并行执行out[i] = f(first[i])
+ * @param[in] first 输入的起点，随机访问迭代器
+ * @param[in] last 输入的终点
+ * @param[out] out 输出的起点，随机访问迭代器，可以与first相同
+ * @param[in] f 变换函数
+ * @param[in] grain 一个任务至少处理的元素数，0为自动选择
+ * @param[in] scheduler 调度器，默认为当前线程的调度器
+ */
+template <class InputIt, class OutputIt, class F>
+OutputIt parallel_transform(InputIt first, InputIt last, OutputIt out, F f, size_t grain = 0,
+                            SchedulerBase *scheduler = SchedulerBase::GetThis())
+{
+    size_t n = std::distance(first, last);
+    if (!grain)
+    {
+        grain = ForkJoin::DefaultGrain(scheduler, n);
+    }
+    parallel_for(0, n, grain, [&](size_t i) { out[i] = f(first[i]); }, scheduler);
+    return out + n;
+}
+
+/**
+ * @brief 并行排序，不稳定
+ * @details 先把序列切成粒度大小的块并行std::sort，再逐轮两两并行归并；
+ * 最后几轮能并行的块对变少，最后一轮是单线程归并
+ * @param[in] first 起点，随机访问迭代器
+ * @param[in] last 终点
+ * @param[in] comp 比较函数
+ * @param[in] grain 块大小，0为自动选择
+ * @param[in] scheduler 调度器，默认为当前线程的调度器
+ */
+template <class RandomIt, class Compare = std::less<>>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp = Compare(), size_t grain = 0,
+                   SchedulerBase *scheduler = SchedulerBase::GetThis())
+{
+    // 块太小时归并的开销超过并行的收益
+    static const size_t kMinSortGrain = 4096;
+    size_t n = std::distance(first, last);
+    if (!grain)
+    {
+        grain = std::max(ForkJoin::DefaultGrain(scheduler, n), kMinSortGrain);
+    }
+    if (!scheduler || n <= grain)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+    size_t blocks = (n + grain - 1) / grain;
+    parallel_for(0, blocks, 1,
+                 [&](size_t i) { std::sort(first + i * grain, first + std::min(n, (i + 1) * grain), comp); },
+                 scheduler);
+    for (size_t width = grain; width < n; width *= 2)
+    {
+        size_t pairs = (n + 2 * width - 1) / (2 * width);
+        parallel_for(0, pairs, 1,
+                     [&](size_t i) {
+                         size_t lo = i * 2 * width;
+                         size_t mid = std::min(n, lo + width);
+                         size_t hi = std::min(n, lo + 2 * width);
+                         if (mid < hi)
+                         {
+                             std::inplace_merge(first + lo, first + mid, first + hi, comp);
+                         }
+                     },
+                     scheduler);
+    }
+}
+
+#endif
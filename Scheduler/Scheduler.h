@@ -3,22 +3,88 @@
 /**
  * @brief 协程调度器
  * @details N-M协程调度器，内部有一个线程池(直接使用sylar的线程池)，
- * 支持协程在线程池中切换
+ * 支持协程在线程池中切换。
+ * BasicScheduler按三个策略实例化：任务队列(QueuePolicy)、锁(LockPolicy)、空闲时的等待方式(IdlePolicy)，
+ * 策略在编译期确定，调度循环里的入队、出队、加锁、唤醒都是直接调用，没有虚函数。
+ * 默认策略与原来的Scheduler行为相同，Scheduler是默认策略的别名；
+ * 单线程、use_caller的调度器可以用NullMutex省掉加锁，空闲线程多时可以用FutexIdle省掉忙等。
+ * NullMutex的调度器只有构造它的线程一个线程：只接受这个线程入队(断言检查)，
+ * 每个任务更新的计数都是普通整数，blocking()在本线程直接执行，不能用switchTo()迁入，不能打开监控线程
  */
+#include <assert.h>
 #include <memory>
 #include "../Mutex/Mutex.h"
+#include "../Mutex/LockProfiler.h"
+#include "../Mutex/ShardedCounter.h"
 #include <string>
 #include <vector>
 #include "../Thread/Threads.h"
 #include "../Coroutine/Coroutine.h"
+#include "SchedulerBase.h"
+#include "SchedulerPolicy.h"
+#include "../util.h"
+#include "../Trace/Tracer.h"
+#include "../Trace/Probes.h"
 #include <list>
+#include <map>
 #include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <signal.h>
+#include <type_traits>
+#include <deque>
 
-class Scheduler
+/**
+ * @brief 弹性工作线程的配置
+ * @details 构造时的线程数是下限，任务队列积压时监控线程逐个增加工作线程直到上限，
+ * 增加出来的线程连续空闲idleMS后退出
+ */
+struct ElasticConfig
+{
+    /// 工作线程数上限(不包括use_caller的主线程)，不大于构造时的线程数表示不扩容
+    size_t maxThreads = 0;
+    /// 任务队列长度达到这个值时扩容，0表示不看长度
+    size_t queueDepth = 64;
+    /// 队首任务等待超过这个时间(微秒)时扩容，0表示不看等待时间
+    uint64_t queueLatencyUS = 1000;
+    /// 增加出来的线程连续空闲这么久(毫秒)后退出
+    uint64_t idleMS = 1000;
+    /// 监控线程检查队列的间隔(微秒)
+    uint64_t checkUS = 1000;
+};
+
+/**
+ * @brief 一次扩容或缩容
+ */
+struct ScaleEvent
+{
+    /// true为扩容，false为缩容
+    bool up = true;
+    /// 发生时间(微秒)
+    uint64_t timeUS = 0;
+    /// 之后的工作线程数(不包括use_caller的主线程和补充线程)
+    size_t threads = 0;
+    /// 当时的任务队列长度
+    size_t queueDepth = 0;
+    /// 扩容时为队首任务已经等待的时间，缩容时为线程连续空闲的时间(微秒)
+    uint64_t timeToScaleUS = 0;
+};
+
+/**
+ * @brief 策略化的协程调度器
+ * @tparam QueuePolicy 任务队列，见SchedulerPolicy.h
+ * @tparam LockPolicy 保护任务队列的锁，Mutex.h中的锁类型
+ * @tparam IdlePolicy 没有任务时的等待方式，见SchedulerPolicy.h
+ */
+template <template <class> class QueuePolicy = ListQueue, class LockPolicy = FutexMutex, class IdlePolicy = SpinIdle>
+class BasicScheduler : public SchedulerBase
 {
 public:
-    typedef std::shared_ptr<Scheduler> ptr;
-    typedef Mutex MutexType;
+    typedef std::shared_ptr<BasicScheduler> ptr;
+    typedef LockPolicy MutexType;
+    /// 不加锁的调度器只能在一个线程上使用
+    static constexpr bool kSingleThread = std::is_same<LockPolicy, NullMutex>::value;
 
     /**
      * @brief 创建调度器
@@ -26,31 +92,116 @@ public:
      * @param[in] use_caller 是否使用当前的线程作为执行任务的线程
      * @param[in] name 名称
      */
-    Scheduler(size_t threads = 1, bool use_caller = true, const std::string &name = "Scheduler");
+    BasicScheduler(size_t threads = 1, bool use_caller = true, const std::string &name = "Scheduler");
 
     /**
      * @brief 析构函数
      */
 
-    virtual ~Scheduler();
+    ~BasicScheduler();
+
+    /**
+     * @brief 设置工作线程的属性(栈大小、CPU亲和性)，在start()之前调用
+     */
+    void setThreadAttr(const ThreadAttr &attr) { m_threadAttr = attr; }
+
+    /**
+     * @brief start()创建并启动所有工作线程花费的时间(微秒)
+     */
+    uint64_t getStartupUS() const { return m_startupUS; }
+
+    /**
+     * @brief 已经执行过的任务数(每次resume算一次)
+     */
+    int64_t getTaskCount() const { return m_taskCount.load(); }
 
     /**
-     * @brief 获取调度器名称
+     * @brief 任务队列和run-next槽中等待执行的任务数，不包括定时任务和fd任务
      */
-    const std::string &getName() const
+    size_t getQueueSize()
     {
-        return m_name;
+        SCOPED_LOCK(MutexType, lock, m_mutex);
+        return m_tasks.size() + m_runNextCount;
     }
 
     /**
-     * @brief 获取当前调度器指针
+     * @brief 等待定时器到期或者fd可读的任务数
      */
-    static Scheduler *GetThis();
+    size_t getPendingCount() const { return m_pendingCount.load(); }
 
     /**
-     * @brief 获取当前线程主协程
+     * @brief 打开卡住的工作线程的监控，在start()之前调用
+     * @details 后台监控线程每stall_ms/2检查一次各工作线程的进度计数，
+     * 同一个任务运行超过stall_ms就认为该线程卡住了(阻塞的系统调用或者死循环)，
+     * 记录告警日志和任务的协程id；任务队列里还有任务时临时补充一个工作线程(类似go sysmon的handoff)，
+     * 卡住的线程恢复后，多出来的补充线程在下一次空闲时退出
+     * @param[in] stall_ms 判定为卡住的时间(毫秒)，0为关闭
+     * @param[in] max_compensating 最多同时存在的补充线程数
      */
-    static Coroutine *GetMainCoroutine();
+    void setWatchdog(uint64_t stall_ms, size_t max_compensating = 1);
+
+    /**
+     * @brief 检测到的卡住次数，同一个任务只算一次
+     */
+    uint64_t getStallCount() const { return m_stallCount.load(); }
+
+    /**
+     * @brief 创建过的补充线程总数
+     */
+    uint64_t getCompensatingSpawned() const { return m_compensatingSpawned.load(); }
+
+    /**
+     * @brief 当前存活的补充线程数
+     */
+    size_t getCompensatingWorkers() const { return m_compensatingWorkers.load(); }
+
+    /**
+     * @brief 打开弹性工作线程，在start()之前调用
+     */
+    void setElastic(const ElasticConfig &config);
+
+    /**
+     * @brief 当前的工作线程数，包括弹性增加的线程，不包括use_caller的主线程和补充线程
+     */
+    size_t getThreadCount() const override { return m_threadCount + m_elasticWorkers.load(); }
+
+    /**
+     * @brief 扩容和缩容的次数
+     */
+    uint64_t getScaleUpCount() const { return m_scaleUpCount.load(); }
+    uint64_t getScaleDownCount() const { return m_scaleDownCount.load(); }
+
+    /**
+     * @brief 最近的扩容和缩容事件，最多保留kMaxScaleEvents个
+     */
+    std::vector<ScaleEvent> getScaleEvents();
+
+    /// 保留的扩容和缩容事件数
+    static const size_t kMaxScaleEvents = 64;
+
+    /**
+     * @brief 获取当前调度器指针，当前线程的调度器不是这种策略时返回nullptr
+     */
+    static BasicScheduler *GetThis() { return dynamic_cast<BasicScheduler *>(SchedulerBase::GetThis()); }
+
+    /**
+     * @brief 把协程放回任务队列，供Coroutine和阻塞调用使用
+     */
+    void scheduleCoroutine(Coroutine::ptr co, int thread) override { schedule(co, thread); }
+
+    /**
+     * @brief SchedulerBase的入队接口，转发给下面的模板
+     */
+    void scheduleFunction(std::function<void()> func, int thread) override { schedule(std::move(func), thread); }
+    void scheduleHandle(std::coroutine_handle<> h, int thread) override { schedule(h, thread); }
+    void scheduleAfter(std::coroutine_handle<> h, uint64_t ms, int thread) override
+    {
+        scheduleAfter<std::coroutine_handle<>>(h, ms, thread);
+    }
+    void scheduleOnReadable(int fd, std::coroutine_handle<> h, int thread) override
+    {
+        scheduleOnReadable<std::coroutine_handle<>>(fd, h, thread);
+    }
 
     /**
      * @brief 添加调度任务
@@ -61,12 +212,13 @@ public:
     template <class CoOrFunc>
     void schedule(CoOrFunc cf, int thread = -1)
     {
+        assertOwner();
         bool need_tickle=false;
         //获得锁，
         //根据scheduler的状态决定是否need_tickle，如果为true
         //则当前任务队列有东西了，就tickle()(通知有任务了)
         {
-            MutexType::Lock lock(m_mutex);
+            SCOPED_LOCK(MutexType, lock, m_mutex);
             need_tickle=scheduleNoLock(cf,thread);
         }
         if(need_tickle)
@@ -75,6 +227,120 @@ public:
         }
     }
 
+    /**
+     * @brief 添加一个马上要执行的任务，放入当前工作线程的run-next槽
+     * @details 用于一个协程唤醒另一个协程的场景(类似go的runnext)，被唤醒者紧接着在
+     * 同一个工作线程上运行，缓存还是热的。槽里原有的任务被挤到任务队列末尾；
+     * 槽中任务超过宽限期没被执行才允许其他线程偷走。
+     * 不在本调度器的工作线程上调用时退化为schedule()
+     * @param[in] cf 协程或者函数
+     */
+    template <class CoOrFunc>
+    void scheduleNext(CoOrFunc cf)
+    {
+        assertOwner();
+        WorkerSlot *slot = currentSlot();
+        if (!slot)
+        {
+            schedule(cf);
+            return;
+        }
+        ScheduleTask task(cf, -1);
+        if (!task.coroutine && !task.func && !task.handle)
+        {
+            return;
+        }
+        YBB_TRACE(SCHEDULE, TraceId(task), t_worker_index);
+        YBB_PROBE3(scheduler__schedule, TraceId(task), 0, -1);
+        {
+            Spinlock::Lock lock(slot->lock);
+            task.enqueueUS = ybb::GetCurrentUS();
+            std::swap(task, slot->runNext);
+            if (!task.coroutine && !task.func && !task.handle)
+            {
+                ++m_runNextCount;
+                return;
+            }
+        }
+        // 被挤出来的任务放回任务队列
+        bool need_tickle = false;
+        {
+            SCOPED_LOCK(MutexType, lock, m_mutex);
+            need_tickle = m_tasks.empty();
+            m_tasks.push_back(task);
+        }
+        if (need_tickle)
+        {
+            tickle();
+        }
+    }
+
+    /**
+     * @brief 延时添加调度任务
+     * @param[in] cf 协程、函数或者无栈协程句柄
+     * @param[in] ms 延时的毫秒数，到期后才放入任务队列
+     * @param[in] thread 指定该任务的线程号，-1为任意线程
+     */
+    template <class CoOrFunc>
+    void scheduleAfter(CoOrFunc cf, uint64_t ms, int thread = -1)
+    {
+        assertOwner();
+        ScheduleTask task(cf, thread);
+        if (!task.coroutine && !task.func && !task.handle)
+        {
+            return;
+        }
+        if (task.coroutine)
+        {
+            task.coroutine->setWaitReason("sleep");
+        }
+        SCOPED_LOCK(MutexType, lock, m_mutex);
+        m_timers.insert(std::make_pair(ybb::GetCurrentMS() + ms, task));
+        ++m_pendingCount;
+    }
+
+    /**
+     * @brief fd可读时添加调度任务
+     * @details 调度循环每轮用poll(0超时)检查一次，适合数量不多的fd
+     * @param[in] fd 等待可读的文件描述符
+     * @param[in] cf 协程、函数或者无栈协程句柄
+     * @param[in] thread 指定该任务的线程号，-1为任意线程
+     */
+    template <class CoOrFunc>
+    void scheduleOnReadable(int fd, CoOrFunc cf, int thread = -1)
+    {
+        assertOwner();
+        ScheduleTask task(cf, thread);
+        if (!task.coroutine && !task.func && !task.handle)
+        {
+            return;
+        }
+        if (task.coroutine)
+        {
+            task.coroutine->setWaitReason("fd readable");
+        }
+        SCOPED_LOCK(MutexType, lock, m_mutex);
+        m_fdWaiters.push_back(std::make_pair(fd, task));
+        ++m_pendingCount;
+    }
+
+    /**
+     * @brief 无栈协程让出执行权的awaiter，把协程句柄重新放回任务队列
+     */
+    struct YieldAwaiter
+    {
+        BasicScheduler *scheduler;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { scheduler->schedule(h); }
+        void await_resume() const noexcept {}
+    };
+
+    /**
+     * @brief co_await scheduler.yield()，无栈协程让出执行权
+     */
+    YieldAwaiter yield() { return YieldAwaiter{this}; }
+
     /**
      * @brief 启动调度器
      */
@@ -90,7 +356,7 @@ protected:
     /**
      * @brief 通知协程调度器有任务了
      */
-    virtual void tickle();
+    void tickle();
 
     /**
      * @brief 协程调度函数
@@ -101,18 +367,22 @@ protected:
     /**
      * @brief 无任务调度时执行idle协程
      */
-    virtual void idle();
+    void idle();
 
     /**
      * @brief 返回是否可以停止
      */
-    virtual bool stopping();
+    bool stopping();
 
     /**
      * @brief 设置当前的协程调度器
      */
     void setThis();
 
+    /**
+     * @brief 把到期的定时任务和fd已就绪的任务移入任务队列
+     */
+    void wakePending();
     /**
      * @brief 返回是否有空闲线程
      * @details 调度协程调度idle协程时该数量+1，返回时-1
@@ -122,44 +392,88 @@ protected:
         return m_idleThreadCount > 0;
     }
 
+    /**
+     * @brief 当前线程是否是正在退出的补充线程，idle协程应该据此返回
+     */
+    bool retiring() const;
+
 private:
     /**
-     * @brief 调度任务，协程/函数二选一，可指定在哪个线程上调度
-     *
+     * @brief 不加锁的调度器只接受构造它的线程入队
+     * @details 构造时已经把当前线程的调度器设为this，其他线程(包括BlockingPool的线程)的t_scheduler不是this
      */
-    struct ScheduleTask
+    void assertOwner() const
     {
-        Coroutine::ptr coroutine;
-        std::function<void()> func;
-        int thread;
-
-        ScheduleTask(Coroutine::ptr c, int thr)
-        {
-            coroutine = c;
-            thread = thr;
-        }
-        ScheduleTask(Coroutine::ptr *c, int thr)
-        {
-            coroutine.swap(*c);
-            thread = thr;
-        }
-        ScheduleTask(std::function<void()> f, int thr)
-        {
-            func = f;
-            thread = thr;
-        }
-        ScheduleTask()
+        if constexpr (kSingleThread)
         {
-            thread = -1;
+            assert(t_scheduler == this && "NullMutex scheduler only accepts tasks from its own thread");
         }
+    }
 
-        void reset()
-        {
-            coroutine = nullptr;
-            func = nullptr;
-            thread = -1;
-        }
-    };
+    /**
+     * @brief 为运行时创建的工作线程预留槽位，在start()之前调用
+     * @param[in] count 至少预留的槽数
+     */
+    void reserveDynamicSlots(size_t count);
+
+    /**
+     * @brief 占用一个空闲的工作线程槽，没有空闲槽时返回m_workerCount
+     */
+    size_t claimSlot();
+
+    /**
+     * @brief 工作线程退出时归还槽位，槽中剩下的run-next任务放回任务队列
+     */
+    void releaseSlot(WorkerSlot &slot);
+
+    /**
+     * @brief 运行时创建一个工作线程，只由监控线程调用
+     * @param[in] elastic true为弹性线程，false为补充线程
+     */
+    void spawnWorker(bool elastic);
+
+    /**
+     * @brief 运行时创建的线程退出前把自己的Thread对象移到待join列表
+     */
+    void retireThread();
+
+    /**
+     * @brief 补充线程多于需要，或者弹性线程空闲太久时，让当前线程退出
+     */
+    bool tryRetire();
+
+    /**
+     * @brief 记录一次扩容或缩容
+     */
+    void addScaleEvent(bool up, size_t depth, uint64_t time_to_scale_us);
+
+    /**
+     * @brief 按照任务队列的积压情况扩容，由监控线程调用
+     */
+    void checkScaleUp();
+
+    /**
+     * @brief 检查卡住的工作线程并补充线程，由监控线程调用
+     */
+    void checkStalls();
+
+    /**
+     * @brief 等待所有工作线程(包括补充线程)结束
+     */
+    void joinWorkers();
+
+    /**
+     * @brief 监控线程的主函数
+     */
+    void monitor();
+
+    /**
+     * @brief 取出run-next槽中的任务
+     * @param[in] slot 工作线程槽
+     * @param[in] min_age_us 任务在槽中至少停留的时间，偷取别人的任务时使用宽限期
+     * @param[out] task 取出的任务
+     */
+    bool takeRunNext(WorkerSlot &slot, uint64_t min_age_us, ScheduleTask &task);
 
     /**
      * @brief 添加调度任务，无锁
@@ -173,32 +487,57 @@ private:
         bool need_tickle=m_tasks.empty();//如果为空，那么scheduler需要被通知加任务了，如果不空，说明这个scheduler是一直在执行的，不需要tickle
 
         ScheduleTask task(cf,thread);
-        if(task.coroutine||task.func)
+        if(task.coroutine||task.func||task.handle)
         {
+            if (m_elasticMax)
+            {
+                // 监控线程据此计算队首任务的等待时间
+                task.enqueueUS = ybb::GetCoarseUS();
+            }
             m_tasks.push_back(task);
+            YBB_TRACE(SCHEDULE, TraceId(task), t_worker_index);
+            YBB_PROBE3(scheduler__schedule, TraceId(task), m_tasks.size(), thread);
         }
         return need_tickle;
     }
 
 
+    // run-next槽中的任务至少等待这么久才允许被其他线程偷取(微秒)
+    static constexpr uint64_t kRunNextStealGraceUS = 50;
+    // 空闲策略一次最多等待这么久(微秒)，定时任务和fd任务靠醒来后的检查
+    static constexpr uint64_t kIdleParkUS = 1000;
+
     // 成员变量
 private:
-    // 协程调度器名称
-    std::string m_name;
     // 互斥锁
     MutexType m_mutex;
     // 线程池
     std::vector<Thread::ptr> m_threads;
     // 任务队列
-    std::list<ScheduleTask> m_tasks;
+    QueuePolicy<ScheduleTask> m_tasks;
+    // 空闲线程的等待方式
+    IdlePolicy m_idlePolicy;
+    // 定时任务，key为到期时间(毫秒)
+    std::multimap<uint64_t, ScheduleTask> m_timers;
+    // 等待fd可读的任务
+    std::list<std::pair<int, ScheduleTask>> m_fdWaiters;
+    // 定时任务和fd任务的总数，调度循环据此判断是否需要检查
+    std::atomic<size_t> m_pendingCount = {0};
+    // 为运行时创建的线程预留的槽数
+    size_t m_dynamicSlots = 0;
+    // run-next槽中的任务数
+    std::atomic<size_t> m_runNextCount = {0};
     // 线程池的线程ID数组
     std::vector<int> m_threadIds;
     // 工作线程数量，不包含use_caller的主线程
     size_t m_threadCount = 0;
+    // 每个任务都要更新的计数，只有一个线程时用普通整数
+    typedef typename std::conditional<kSingleThread, size_t, std::atomic<size_t>>::type ThreadCounter;
+    typedef typename std::conditional<kSingleThread, LocalCounter, ShardedCounter>::type TaskCounter;
     // 活跃线程数量
-    std::atomic<size_t> m_activeThreadCount = {0};
+    ThreadCounter m_activeThreadCount = {0};
     // idle线程数
-    std::atomic<size_t> m_idleThreadCount = {0};
+    ThreadCounter m_idleThreadCount = {0};
 
     // 是否use_caller
     bool m_useCaller;
@@ -209,6 +548,45 @@ private:
 
     // 是否正在停止
     bool m_stopping = false;
+    // 工作线程属性
+    ThreadAttr m_threadAttr;
+    // 启动工作线程花费的时间(微秒)
+    uint64_t m_startupUS = 0;
+    // 已经执行过的任务数，每个工作线程更新自己的分片
+    TaskCounter m_taskCount;
+    size_t m_maxCompensating = 0;
+    // 监控线程，检查卡住的线程和任务队列的积压
+    Thread::ptr m_monitor;
+    // 通知监控线程退出
+    Semaphore m_monitorSem;
+    // 已经退出调度循环、等待join的补充线程和弹性线程
+    std::vector<Thread::ptr> m_retiredThreads;
+    // 存活的补充线程数和需要的补充线程数
+    std::atomic<size_t> m_compensatingWorkers = {0};
+    std::atomic<size_t> m_compensatingTarget = {0};
+    // 监控统计
+    std::atomic<uint64_t> m_stallCount = {0};
+    std::atomic<uint64_t> m_compensatingSpawned = {0};
+    // 弹性线程配置，m_elasticMax为最多增加的线程数，0为不扩容
+    ElasticConfig m_elastic;
+    size_t m_elasticMax = 0;
+    // 存活的弹性线程数
+    std::atomic<size_t> m_elasticWorkers = {0};
+    // 扩容缩容统计
+    std::atomic<uint64_t> m_scaleUpCount = {0};
+    std::atomic<uint64_t> m_scaleDownCount = {0};
+    // 最近的扩容缩容事件，由m_mutex保护
+    std::deque<ScaleEvent> m_scaleEvents;
 };
 
-#endif
\ No newline at end of file
+#include "SchedulerImpl.h"
+
+// 默认策略在Scheduler.cpp中显式实例化
+extern template class BasicScheduler<ListQueue, FutexMutex, SpinIdle>;
+
+/**
+ * @brief 默认策略的调度器：链表任务队列、FutexMutex、空闲时忙等
+ */
+typedef BasicScheduler<> Scheduler;
+
+#endif
@@ -0,0 +1,240 @@
+#include "SchedulerBase.h"
+#include "BlockingPool.h"
+#include "../Log/Log.h"
+#include <errno.h>
+#include <mutex>
+#include <string.h>
+
+thread_local SchedulerBase *SchedulerBase::t_scheduler = nullptr;
+thread_local Coroutine *SchedulerBase::t_scheduler_coroutine = nullptr;
+thread_local size_t SchedulerBase::t_worker_index = SchedulerBase::kNoWorker;
+thread_local SchedulerBase::WorkerKind SchedulerBase::t_worker_kind = SchedulerBase::STATIC_WORKER;
+thread_local bool SchedulerBase::t_worker_retiring = false;
+thread_local uint64_t SchedulerBase::t_idle_since_us = 0;
+thread_local volatile sig_atomic_t SchedulerBase::t_preempt_pending = 0;
+
+// 时间片信号
+static const int kPreemptSignal = SIGURG;
+
+SchedulerBase::SchedulerBase(const std::string &name)
+    : m_name(name)
+{
+}
+
+SchedulerBase::~SchedulerBase()
+{
+    if (t_scheduler == this)
+    {
+        t_scheduler = nullptr;
+    }
+}
+
+SchedulerBase *SchedulerBase::GetThis()
+{
+    return t_scheduler;
+}
+
+Coroutine *SchedulerBase::GetMainCoroutine()
+{
+    return t_scheduler_coroutine;
+}
+
+Coroutine *SchedulerBase::GetTaskCoroutine()
+{
+    Coroutine *co = Coroutine::GetCurrent();
+    if (!t_scheduler || !co || co == t_scheduler_coroutine || !co->getStack() || co->getScheduler() != t_scheduler)
+    {
+        return nullptr;
+    }
+    return co;
+}
+
+SchedulerBase::WorkerSlot *SchedulerBase::currentSlot()
+{
+    if (t_scheduler != this || t_worker_index >= m_workerCount)
+    {
+        return nullptr;
+    }
+    return &m_workers[t_worker_index];
+}
+
+void SchedulerBase::beginTask(WorkerSlot &slot, uint64_t id)
+{
+    // 上一个任务没来得及响应的抢占标记作废
+    t_preempt_pending = 0;
+    t_idle_since_us = 0;
+    if (m_stallMS)
+    {
+        slot.currentTask.store(id, std::memory_order_relaxed);
+        slot.taskBeginUS.store(ybb::GetCoarseUS(), std::memory_order_relaxed);
+    }
+    slot.dispatchSeq.store(slot.dispatchSeq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    slot.inTask.store(true, std::memory_order_relaxed);
+}
+
+bool SchedulerBase::startPreemptTimer(timer_t &timer)
+{
+    static std::once_flag s_install;
+    std::call_once(s_install, []() {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &SchedulerBase::OnPreemptSignal;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(kPreemptSignal, &sa, nullptr);
+    });
+
+    // 定时器只向本线程发信号
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = kPreemptSignal;
+    sev._sigev_un._tid = ybb::GetThreadId();
+    if (timer_create(CLOCK_MONOTONIC, &sev, &timer))
+    {
+        YBB_LOG_ERROR("timer_create failed: %s", strerror(errno));
+        return false;
+    }
+    struct itimerspec its;
+    its.it_interval.tv_sec = m_preemptSliceUS / 1000000;
+    its.it_interval.tv_nsec = m_preemptSliceUS % 1000000 * 1000;
+    its.it_value = its.it_interval;
+    if (timer_settime(timer, 0, &its, nullptr))
+    {
+        YBB_LOG_ERROR("timer_settime failed: %s", strerror(errno));
+        timer_delete(timer);
+        return false;
+    }
+    return true;
+}
+
+void SchedulerBase::OnPreemptSignal(int, siginfo_t *, void *)
+{
+    int saved = errno;
+    SchedulerBase *scheduler = t_scheduler;
+    if (!scheduler || t_worker_index >= scheduler->m_workerCount)
+    {
+        errno = saved;
+        return;
+    }
+    WorkerSlot &slot = scheduler->m_workers[t_worker_index];
+    uint64_t seq = slot.dispatchSeq.load(std::memory_order_relaxed);
+    if (!slot.inTask.load(std::memory_order_relaxed) || seq != slot.tickSeq)
+    {
+        // 上一个时间片之后换过任务，重新计时
+        slot.tickSeq = seq;
+        errno = saved;
+        return;
+    }
+    // 同一个任务跑满了一个时间片
+    scheduler->m_preemptRequestCount.inc();
+    t_preempt_pending = 1;
+
+    Coroutine *co = Coroutine::GetCurrent();
+    if (scheduler->m_allowForcedPreempt && co && co->isPreemptible() && co->getStack() &&
+        co->getScheduler() == scheduler && co->getState() == Coroutine::RUNNING)
+    {
+        // 被打断的位置必须在协程自己的栈上，而不是正在切换的调度代码里
+        char here;
+        uintptr_t sp = (uintptr_t)&here;
+        uintptr_t lo = (uintptr_t)co->getStack();
+        if (sp >= lo && sp < lo + co->getStackSize())
+        {
+            t_preempt_pending = 0;
+            scheduler->m_forcedPreemptCount.inc();
+            // 信号栈帧在协程栈上，放回同一个线程，切回来后从这里返回，再由sigreturn恢复被打断的位置
+            co->reschedule(ybb::GetThreadId());
+        }
+    }
+    errno = saved;
+}
+
+void SchedulerBase::runBlocking(const std::function<void()> &job, bool same_worker)
+{
+    SchedulerBase *scheduler = t_scheduler;
+    Coroutine *co = GetTaskCoroutine();
+    if (!co || !scheduler->m_remoteEnqueue)
+    {
+        // 没有可以挂起的协程，或者BlockingPool的线程不能把协程放回单线程的调度器
+        job();
+        return;
+    }
+    int thread = same_worker ? ybb::GetThreadId() : -1;
+    ++scheduler->m_blockingCount;
+    co->setWaitReason("blocking");
+    // job在协程栈上，协程挂起期间一直有效
+    co->suspend([scheduler, thread, &job](Coroutine::ptr self) {
+        BlockingPool::Get().submit([scheduler, thread, &job, self]() {
+            job();
+            scheduler->scheduleCoroutine(self, thread);
+            --scheduler->m_blockingCount;
+        });
+    });
+}
+
+bool SchedulerBase::switchTo(SchedulerBase &target, int thread)
+{
+    Coroutine *co = GetTaskCoroutine();
+    if (!co)
+    {
+        return false;
+    }
+    if (&target == t_scheduler && (thread == -1 || thread == ybb::GetThreadId()))
+    {
+        return true;
+    }
+    if (!target.m_remoteEnqueue)
+    {
+        return false;
+    }
+    co->setWaitReason("switch scheduler");
+    // 切换完成后才入队，目标线程不会在协程让出之前恢复它
+    co->suspend([&target, thread](Coroutine::ptr self) { target.scheduleCoroutine(self, thread); });
+    return true;
+}
+
+SchedulerSwitchScope::SchedulerSwitchScope(SchedulerBase &target, int thread, bool same_worker)
+{
+    SchedulerBase *origin = SchedulerBase::GetThis();
+    // 迁回时在target的线程上把协程放入origin
+    if (!origin || &target == origin || !origin->m_remoteEnqueue)
+    {
+        return;
+    }
+    int origin_thread = same_worker ? ybb::GetThreadId() : -1;
+    ++origin->m_awayCount;
+    if (!SchedulerBase::switchTo(target, thread))
+    {
+        --origin->m_awayCount;
+        return;
+    }
+    m_origin = origin;
+    m_originThread = origin_thread;
+}
+
+SchedulerSwitchScope::~SchedulerSwitchScope()
+{
+    if (!m_origin)
+    {
+        return;
+    }
+    SchedulerBase::switchTo(*m_origin, m_originThread);
+    --m_origin->m_awayCount;
+}
+
+void maybe_yield()
+{
+    if (!SchedulerBase::t_preempt_pending)
+    {
+        return;
+    }
+    SchedulerBase::t_preempt_pending = 0;
+    Coroutine *co = SchedulerBase::GetTaskCoroutine();
+    // 无栈协程和调度协程本身不能让出
+    if (!co)
+    {
+        return;
+    }
+    SchedulerBase::t_scheduler->m_preemptCount.inc();
+    co->reschedule();
+}
@@ -0,0 +1,435 @@
+#ifndef SCHEDULER_BASE_H
+#define SCHEDULER_BASE_H
+/**
+ * @brief 调度器的非模板基类
+ * @details BasicScheduler按任务队列、锁、空闲策略实例化出不同的类型，
+ * 与策略无关的部分放在这里：线程局部变量(当前调度器、调度协程、工作线程槽)、
+ * 工作线程槽、时间片抢占和阻塞调用。Coroutine、maybe_yield()、无栈协程的awaiter和并行算法等
+ * 不知道具体策略的代码只通过基类访问调度器，入队用下面几个虚函数，每次入队多一次虚函数调用
+ */
+#include <memory>
+#include "../Mutex/Mutex.h"
+#include "../Mutex/ShardedCounter.h"
+#include <string>
+#include <functional>
+#include "../Coroutine/Coroutine.h"
+#include "../util.h"
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <signal.h>
+#include <type_traits>
+
+class SchedulerBase : Noncopyable
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] name 名称
+     */
+    SchedulerBase(const std::string &name);
+
+    /**
+     * @brief 析构函数
+     */
+    virtual ~SchedulerBase();
+
+    /**
+     * @brief 获取调度器名称
+     */
+    const std::string &getName() const
+    {
+        return m_name;
+    }
+
+    /**
+     * @brief 打开时间片抢占，在start()之前调用
+     * @details 每个工作线程一个定时器，每个时间片向本线程发一次信号；
+     * 同一个任务跑满一个时间片后设置抢占标记，任务在maybe_yield()处让出。
+     * allow_forced为true时，处于PreemptibleScope中的协程会在信号处理函数里被直接切走，
+     * 之后放回同一个线程继续执行
+     * @param[in] slice_us 时间片长度(微秒)，0为关闭
+     * @param[in] allow_forced 是否允许强制切换
+     */
+    void setPreemption(uint64_t slice_us, bool allow_forced = false)
+    {
+        m_preemptSliceUS = slice_us;
+        m_allowForcedPreempt = allow_forced;
+    }
+
+    /**
+     * @brief 时间片用完的次数
+     */
+    int64_t getPreemptRequestCount() const { return m_preemptRequestCount.load(); }
+
+    /**
+     * @brief 在maybe_yield()处让出的次数
+     */
+    int64_t getPreemptCount() const { return m_preemptCount.load(); }
+
+    /**
+     * @brief 在信号处理函数中被强制切走的次数
+     */
+    int64_t getForcedPreemptCount() const { return m_forcedPreemptCount.load(); }
+
+    /**
+     * @brief 把阻塞调用交给BlockingPool执行，当前协程挂起到调用完成
+     * @details f在其他线程上执行，工作线程在此期间继续执行别的任务；
+     * 完成后协程被放回原来的调度器，返回f的结果，f抛出的异常在协程中重新抛出。
+     * 不在调度器的协程中调用时(包括无栈协程)，或者调度器不接受其他线程入队(NullMutex)时，直接在当前线程执行f
+     * @param[in] f 阻塞调用
+     * @param[in] same_worker 是否回到原来的工作线程继续执行
+     */
+    template <class F>
+    static std::invoke_result_t<F> blocking(F f, bool same_worker = false)
+    {
+        typedef std::invoke_result_t<F> R;
+        std::exception_ptr error;
+        if constexpr (std::is_void_v<R>)
+        {
+            runBlocking(
+                [&]() {
+                    try
+                    {
+                        f();
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                },
+                same_worker);
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+        else
+        {
+            std::optional<R> result;
+            runBlocking(
+                [&]() {
+                    try
+                    {
+                        result.emplace(f());
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                },
+                same_worker);
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+            return std::move(*result);
+        }
+    }
+
+    /**
+     * @brief 挂在BlockingPool上还没回来的协程数
+     */
+    size_t getBlockingCount() const { return m_blockingCount.load(); }
+
+    /**
+     * @brief 把当前协程迁移到另一个调度器上继续执行
+     * @details 当前协程让出，切换完成后放入target的任务队列，由target的工作线程恢复，
+     * 之后GetThis()返回target。用于CPU密集和IO密集分开两个调度器时，同一个请求在两边接力执行，
+     * 不需要额外的线程。target必须已经启动并且还没有停止。
+     * 不在调度器的协程中调用时(包括无栈协程)，或者target不接受其他线程入队(NullMutex)时不迁移，返回false
+     * @param[in] target 目标调度器
+     * @param[in] thread 指定目标调度器中的线程号，-1为任意线程
+     */
+    static bool switchTo(SchedulerBase &target, int thread = -1);
+
+    /**
+     * @brief 迁移出去、还会回来的协程数
+     */
+    size_t getAwayCount() const { return m_awayCount.load(); }
+
+    /**
+     * @brief 把协程放回任务队列
+     * @details 协程切换完成后放回自己(reschedule、yield_to)、阻塞调用完成后放回协程时使用
+     * @param[in] co 就绪的协程
+     * @param[in] thread 指定执行的线程号，-1为任意线程
+     */
+    virtual void scheduleCoroutine(Coroutine::ptr co, int thread) = 0;
+
+    /**
+     * @brief 添加函数任务，供并行算法和任务图使用
+     * @param[in] func 函数
+     * @param[in] thread 指定执行的线程号，-1为任意线程
+     */
+    virtual void scheduleFunction(std::function<void()> func, int thread) = 0;
+
+    /**
+     * @brief 把无栈协程句柄放入任务队列，供spawn()使用
+     * @param[in] h 无栈协程句柄
+     * @param[in] thread 指定执行的线程号，-1为任意线程
+     */
+    virtual void scheduleHandle(std::coroutine_handle<> h, int thread) = 0;
+
+    /**
+     * @brief ms毫秒后把无栈协程句柄放入任务队列，供sleep_for使用
+     */
+    virtual void scheduleAfter(std::coroutine_handle<> h, uint64_t ms, int thread) = 0;
+
+    /**
+     * @brief fd可读时把无栈协程句柄放入任务队列，供fd_readable使用
+     */
+    virtual void scheduleOnReadable(int fd, std::coroutine_handle<> h, int thread) = 0;
+
+    /**
+     * @brief 当前的工作线程数，并行算法据此决定拆分粒度
+     */
+    virtual size_t getThreadCount() const = 0;
+
+    /**
+     * @brief 获取当前线程的调度器，不论是哪种策略
+     */
+    static SchedulerBase *GetThis();
+
+    /**
+     * @brief 获取当前线程主协程
+     */
+    static Coroutine *GetMainCoroutine();
+
+    /**
+     * @brief 获取当前线程上正在执行的、可以挂起后放回调度器的有栈协程
+     * @details 不在调度器的工作线程上、在调度协程本身(包括无栈协程)上执行时返回nullptr
+     */
+    static Coroutine *GetTaskCoroutine();
+
+protected:
+    /**
+     * @brief 调度任务，协程/函数/无栈协程句柄三选一，可指定在哪个线程上调度
+     *
+     */
+    struct ScheduleTask
+    {
+        Coroutine::ptr coroutine;
+        std::function<void()> func;
+        std::coroutine_handle<> handle;
+        int thread;
+        // 进入run-next槽或者任务队列的时间(微秒)
+        uint64_t enqueueUS = 0;
+
+        ScheduleTask(Coroutine::ptr c, int thr)
+        {
+            coroutine = c;
+            thread = thr;
+        }
+        ScheduleTask(Coroutine::ptr *c, int thr)
+        {
+            coroutine.swap(*c);
+            thread = thr;
+        }
+        ScheduleTask(std::function<void()> f, int thr)
+        {
+            func = f;
+            thread = thr;
+        }
+        ScheduleTask(std::coroutine_handle<> h, int thr)
+        {
+            handle = h;
+            thread = thr;
+        }
+        ScheduleTask()
+        {
+            thread = -1;
+        }
+
+        void reset()
+        {
+            coroutine = nullptr;
+            func = nullptr;
+            handle = nullptr;
+            thread = -1;
+            enqueueUS = 0;
+        }
+    };
+
+    /**
+     * @brief 每个工作线程一份的状态，按缓存行对齐避免伪共享
+     */
+    struct alignas(kCacheLineSize) WorkerSlot
+    {
+        // 保护runNext
+        Spinlock lock;
+        // run-next槽，工作线程下一个优先执行的任务
+        ScheduleTask runNext;
+        // 每开始执行一个任务加一，时间片信号据此判断是不是同一个任务跑满了一个时间片
+        std::atomic<uint64_t> dispatchSeq = {0};
+        // 上一次时间片信号看到的dispatchSeq，只在本线程的信号处理函数中访问
+        uint64_t tickSeq = 0;
+        // 是否正在执行任务
+        std::atomic<bool> inTask = {false};
+        // 是否已经被某个工作线程占用
+        std::atomic<bool> used = {false};
+        // 正在执行的任务id和开始时间(微秒)，只在打开监控时更新
+        std::atomic<uint64_t> currentTask = {0};
+        std::atomic<uint64_t> taskBeginUS = {0};
+        // 监控线程已经报告过的dispatchSeq，只在监控线程中访问
+        uint64_t reportedSeq = 0;
+    };
+
+    /**
+     * @brief 工作线程的种类
+     */
+    enum WorkerKind
+    {
+        // start()创建的线程和use_caller的主线程
+        STATIC_WORKER,
+        // 有线程卡住时监控线程创建的补充线程
+        COMPENSATING_WORKER,
+        // 任务积压时监控线程创建的弹性线程
+        ELASTIC_WORKER
+    };
+
+    /// 不是工作线程时的工作线程槽序号
+    static const size_t kNoWorker = (size_t)-1;
+
+    /**
+     * @brief 任务在追踪事件中的id：协程id或者无栈协程地址，函数任务为0
+     */
+    static uint64_t TraceId(const ScheduleTask &task)
+    {
+        return task.coroutine ? task.coroutine->getId() : (uint64_t)(uintptr_t)task.handle.address();
+    }
+
+    /**
+     * @brief 返回当前线程在本调度器中的工作线程槽，不是本调度器的工作线程时返回nullptr
+     */
+    WorkerSlot *currentSlot();
+
+    /**
+     * @brief 标记工作线程开始执行一个任务
+     * @param[in] slot 工作线程槽
+     * @param[in] id 任务id，与追踪事件中的id相同
+     */
+    void beginTask(WorkerSlot &slot, uint64_t id);
+
+    /**
+     * @brief 为当前工作线程创建时间片定时器
+     */
+    bool startPreemptTimer(timer_t &timer);
+
+    /**
+     * @brief 时间片信号处理函数
+     */
+    static void OnPreemptSignal(int signo, siginfo_t *info, void *uctx);
+
+    /**
+     * @brief blocking()的实现，job不会抛出异常
+     */
+    static void runBlocking(const std::function<void()> &job, bool same_worker);
+
+    friend void maybe_yield();
+    friend class SchedulerSwitchScope;
+
+protected:
+    // 当前线程的调度器
+    static thread_local SchedulerBase *t_scheduler;
+    // 当前线程的调度协程，每个线程都独有一份
+    static thread_local Coroutine *t_scheduler_coroutine;
+    // 当前线程在调度器中的工作线程槽序号，只在run()中有效，其他时候为kNoWorker
+    static thread_local size_t t_worker_index;
+    // 当前线程是哪种工作线程
+    static thread_local WorkerKind t_worker_kind;
+    // 运行时创建的线程是否正在退出
+    static thread_local bool t_worker_retiring;
+    // 弹性线程开始连续空闲的时间(微秒)，0为正在执行任务
+    static thread_local uint64_t t_idle_since_us;
+    // 当前线程正在执行的任务用完了时间片，在maybe_yield()处让出
+    static thread_local volatile sig_atomic_t t_preempt_pending;
+
+    // 协程调度器名称
+    std::string m_name;
+    // 工作线程槽，包含use_caller的主线程
+    std::unique_ptr<WorkerSlot[]> m_workers;
+    // 工作线程槽数量，包括为运行时创建的线程预留的槽
+    size_t m_workerCount = 0;
+    // 时间片长度(微秒)，0为不抢占
+    uint64_t m_preemptSliceUS = 0;
+    // 是否允许强制切换
+    bool m_allowForcedPreempt = false;
+    // 抢占统计
+    ShardedCounter m_preemptRequestCount;
+    ShardedCounter m_preemptCount;
+    ShardedCounter m_forcedPreemptCount;
+    // 判定为卡住的时间(毫秒)，0为不监控
+    uint64_t m_stallMS = 0;
+    // 正在执行阻塞调用的协程数，回来之前调度器不能停止
+    std::atomic<size_t> m_blockingCount = {0};
+    // 被SchedulerSwitchScope迁移出去的协程数，回来之前调度器不能停止
+    std::atomic<size_t> m_awayCount = {0};
+    // 其他线程能否把协程放入本调度器：blocking()完成后放回、switchTo()迁入都需要，单线程的调度器不能
+    bool m_remoteEnqueue = true;
+};
+
+/**
+ * @brief 抢占检查点
+ * @details 当前任务用完时间片时把当前协程放回任务队列并让出，否则立即返回。
+ * 长时间运行的计算循环应该定期调用
+ */
+void maybe_yield();
+
+/**
+ * @brief 在作用域内允许当前协程被时间片信号强制切走
+ * @details 强制切换可能发生在任意一条指令上，作用域内只能做纯计算，
+ * 不能持有锁、分配内存或者调用非异步信号安全的函数。
+ * 作用域内可以调用maybe_yield()、blocking()、switchTo()：协程主动切换期间不会被强制切走。
+ * 只有调度器setPreemption(slice, true)时才生效
+ */
+class PreemptibleScope : Noncopyable
+{
+public:
+    PreemptibleScope()
+        : m_coroutine(Coroutine::GetCurrent()), m_prev(m_coroutine && m_coroutine->isPreemptible())
+    {
+        if (m_coroutine)
+        {
+            m_coroutine->setPreemptible(true);
+        }
+    }
+
+    ~PreemptibleScope()
+    {
+        if (m_coroutine)
+        {
+            m_coroutine->setPreemptible(m_prev);
+        }
+    }
+
+private:
+    Coroutine *m_coroutine;
+    bool m_prev;
+};
+
+/**
+ * @brief 在作用域内把当前协程迁移到另一个调度器，离开作用域时迁回原来的调度器
+ * @details 迁出期间原调度器的stop()会等协程回来。
+ * 不在调度器的协程中，或者任何一边不接受其他线程入队时什么也不做
+ */
+class SchedulerSwitchScope : Noncopyable
+{
+public:
+    /**
+     * @param[in] target 作用域内使用的调度器
+     * @param[in] thread 指定目标调度器中的线程号，-1为任意线程
+     * @param[in] same_worker 迁回时是否回到原来的工作线程
+     */
+    SchedulerSwitchScope(SchedulerBase &target, int thread = -1, bool same_worker = false);
+
+    ~SchedulerSwitchScope();
+
+private:
+    // 原来的调度器，没有迁移时为nullptr
+    SchedulerBase *m_origin = nullptr;
+    // 迁回时指定的线程号
+    int m_originThread = -1;
+};
+
+#endif
@@ -0,0 +1,749 @@
+/**
+ * @file SchedulerImpl.h
+ * @brief BasicScheduler的成员函数定义，由Scheduler.h在末尾包含
+ * @details 默认策略的实例在Scheduler.cpp中显式实例化，
+ * 其他策略组合在使用的翻译单元中隐式实例化
+ */
+#ifndef SCHEDULER_IMPL_H
+#define SCHEDULER_IMPL_H
+
+#include <assert.h>
+#include <poll.h>
+#include "../util.h"
+#include "../Mutex/Rcu.h"
+#include "../Log/Log.h"
+
+/**
+ * @brief 初始化调度线程池，如果只使用caller线程进行调度，那这个方法啥也不做
+ * @param[in] threads 线程数量
+ * @param[in] use_caller 是否使用当前的线程作为执行任务的线程
+ * @param[in] name 名称
+ */
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::BasicScheduler(size_t threads, bool use_caller, const std::string &name)
+    : SchedulerBase(name)
+{
+    assert(threads > 0);
+    // 不加锁时只能有构造者这一个线程
+    assert(!kSingleThread || (use_caller && threads == 1));
+    m_useCaller = use_caller;
+    m_remoteEnqueue = !kSingleThread;
+
+    if (use_caller)
+    {
+        --threads;
+        Coroutine::GetThis();
+        assert(SchedulerBase::GetThis() == nullptr);
+        t_scheduler = this;
+        /**
+         * 在user_caller为true时，初始化caller线程的调度协程
+         * caller线程的调度协程不会被调度器所调度，caller线程的调度协程停止时，应返回caller线程的主协程
+         */
+        m_scheduleCoroutine.reset(new Coroutine(std::bind(&BasicScheduler::run, this), 0, false));
+
+        Thread::SetName(m_name);
+        t_scheduler_coroutine = m_scheduleCoroutine.get();
+        m_rootThread = ybb::GetThreadId();
+        m_threadIds.push_back(m_rootThread);
+    }
+    else
+    {
+        m_rootThread = -1;
+    }
+    m_threadCount = threads;
+    m_workerCount = threads + (use_caller ? 1 : 0);
+    m_workers.reset(new WorkerSlot[m_workerCount]);
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::~BasicScheduler()
+{
+    YBB_LOG_DEBUG("Scheduler::~Scheduler()");
+    assert(m_stopping);
+}
+
+/**
+ * @brief 启动调度器
+ */
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::start()
+{
+    YBB_LOG_DEBUG("Scheduler start");
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+
+    if (m_stopping)
+    {
+        YBB_LOG_WARN("Scheduler is stopped");
+        return;
+    }
+    assert(m_threads.empty());
+    m_threads.resize(m_threadCount);
+
+    uint64_t begin = ybb::GetCurrentUS();
+    // 先把所有线程都创建出来，再一起等待它们启动，线程的启动过程可以并行
+    for (size_t i = 0; i < m_threadCount; i++)
+    {
+        m_threads[i].reset(new Thread(std::bind(&BasicScheduler::run, this), m_name + '_' + std::to_string(i),
+                                      m_threadAttr, false));
+    }
+    for (size_t i = 0; i < m_threadCount; i++)
+    {
+        m_threads[i]->waitStarted();
+        m_threadIds.push_back(m_threads[i]->getId());
+    }
+    m_startupUS = ybb::GetCurrentUS() - begin;
+    if (m_stallMS || m_elasticMax)
+    {
+        m_monitor.reset(new Thread(std::bind(&BasicScheduler::monitor, this), m_name + "_monitor"));
+    }
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::setWatchdog(uint64_t stall_ms, size_t max_compensating)
+{
+    static_assert(!kSingleThread, "the monitor thread would race with a NullMutex scheduler");
+    m_stallMS = stall_ms;
+    m_maxCompensating = stall_ms ? max_compensating : 0;
+    reserveDynamicSlots(m_maxCompensating + m_elasticMax);
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::setElastic(const ElasticConfig &config)
+{
+    static_assert(!kSingleThread, "the monitor thread would race with a NullMutex scheduler");
+    m_elastic = config;
+    m_elasticMax = config.maxThreads > m_threadCount ? config.maxThreads - m_threadCount : 0;
+    reserveDynamicSlots(m_maxCompensating + m_elasticMax);
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+std::vector<ScaleEvent> BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::getScaleEvents()
+{
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+    return std::vector<ScaleEvent>(m_scaleEvents.begin(), m_scaleEvents.end());
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::reserveDynamicSlots(size_t count)
+{
+    assert(m_threads.empty());
+    if (count <= m_dynamicSlots)
+    {
+        return;
+    }
+    m_workerCount += count - m_dynamicSlots;
+    m_dynamicSlots = count;
+    m_workers.reset(new WorkerSlot[m_workerCount]);
+}
+
+// 所有任务都执行完了才能stop
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+bool BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::stopping()
+{
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+    return m_tasks.empty() && m_pendingCount == 0 && m_runNextCount == 0 && m_activeThreadCount == 0 &&
+           m_blockingCount == 0 && m_awayCount == 0 && m_stopping;
+}
+/**
+ * @brief 设置当前的协程调度器
+ */
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::setThis()
+{
+    t_scheduler=this;
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+bool BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::takeRunNext(WorkerSlot &slot, uint64_t min_age_us, ScheduleTask &task)
+{
+    Spinlock::Lock lock(slot.lock);
+    ScheduleTask &next = slot.runNext;
+    if (!next.coroutine && !next.func && !next.handle)
+    {
+        return false;
+    }
+    if (min_age_us && ybb::GetCurrentUS() - next.enqueueUS < min_age_us)
+    {
+        return false;
+    }
+    task = next;
+    next.reset();
+    --m_runNextCount;
+    return true;
+}
+
+/**
+ * @brief 把到期的定时任务和fd已就绪的任务移入任务队列
+ */
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::wakePending()
+{
+    if (m_pendingCount == 0)
+    {
+        return;
+    }
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+    uint64_t now = ybb::GetCurrentMS();
+    auto end = m_timers.upper_bound(now);
+    for (auto it = m_timers.begin(); it != end; ++it)
+    {
+        m_tasks.push_back(it->second);
+        YBB_TRACE(SCHEDULE, TraceId(it->second), t_worker_index);
+        YBB_PROBE3(scheduler__schedule, TraceId(it->second), m_tasks.size(), it->second.thread);
+        --m_pendingCount;
+    }
+    m_timers.erase(m_timers.begin(), end);
+
+    if (m_fdWaiters.empty())
+    {
+        return;
+    }
+    std::vector<struct pollfd> fds;
+    fds.reserve(m_fdWaiters.size());
+    for (auto &i : m_fdWaiters)
+    {
+        fds.push_back({i.first, POLLIN, 0});
+    }
+    if (poll(&fds[0], fds.size(), 0) <= 0)
+    {
+        return;
+    }
+    size_t idx = 0;
+    for (auto it = m_fdWaiters.begin(); it != m_fdWaiters.end(); ++idx)
+    {
+        if (fds[idx].revents)
+        {
+            m_tasks.push_back(it->second);
+            YBB_TRACE(SCHEDULE, TraceId(it->second), t_worker_index);
+            YBB_PROBE3(scheduler__schedule, TraceId(it->second), m_tasks.size(), it->second.thread);
+            m_fdWaiters.erase(it++);
+            --m_pendingCount;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+/**
+ * @brief 协程调度函数
+ */
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::run()
+{
+    YBB_LOG_DEBUG("Scheduler run");
+    setThis();
+
+    if (ybb::GetThreadId() != m_rootThread)
+    {
+        t_scheduler_coroutine = Coroutine::GetThis().get();
+    }
+    t_worker_index = claimSlot();
+    if (t_worker_index >= m_workerCount)
+    {
+        // 只有运行时创建的线程会拿不到槽：刚退出的线程还没来得及归还
+        assert(t_worker_kind != STATIC_WORKER);
+        YBB_LOG_WARN("%s: no free worker slot for new worker", m_name.c_str());
+        t_worker_index = kNoWorker;
+        --(t_worker_kind == ELASTIC_WORKER ? m_elasticWorkers : m_compensatingWorkers);
+        retireThread();
+        return;
+    }
+    WorkerSlot &my_slot = m_workers[t_worker_index];
+    // 工作线程以调度循环的每一轮作为RCU静止状态，任务中的读临界区不需要任何开销
+    Rcu::RegisterThread();
+    timer_t preempt_timer;
+    bool has_preempt_timer = m_preemptSliceUS && startPreemptTimer(preempt_timer);
+
+    // 挂机协程
+    Coroutine::ptr idle_coroutine(new Coroutine(std::bind(&BasicScheduler::idle, this)));
+    Coroutine::ptr func_coroutine;
+    ScheduleTask task;
+    while (true)
+    {
+        task.reset();
+        bool tickle_me = false; // 是否tickle其他线程进行任务调度
+        // 两个任务之间当前线程不在任何读临界区内
+        Rcu::Quiescent();
+        wakePending();
+        // 优先执行自己run-next槽中的任务
+        if (m_runNextCount && takeRunNext(my_slot, 0, task))
+        {
+            YBB_PROBE3(scheduler__dequeue, TraceId(task), 0, t_worker_index);
+            ++m_activeThreadCount;
+        }
+        else
+        {
+            SCOPED_LOCK(MutexType, lock, m_mutex);
+            // 取出第一个指定任意线程或者当前线程的任务，
+            // 跳过了指定其他线程的任务，或者取完还有任务时，需要通知其他线程进行调度
+            int thread_id = ybb::GetThreadId();
+            bool skipped = false;
+            if (m_tasks.take([thread_id](const ScheduleTask &t) { return t.thread == -1 || t.thread == thread_id; },
+                             task, skipped))
+            {
+                assert(task.coroutine || task.func || task.handle);
+                if (task.coroutine)
+                {
+                    // 任务队列中的协程应该都是ready的
+                    assert(task.coroutine->getState() == Coroutine::READY);
+                }
+                YBB_PROBE3(scheduler__dequeue, TraceId(task), m_tasks.size(), t_worker_index);
+                ++m_activeThreadCount;
+            }
+            tickle_me = skipped || !m_tasks.empty();
+        }
+        // 任务队列里没有可执行的任务，偷取其他线程超过宽限期的run-next任务
+        if (!task.coroutine && !task.func && !task.handle && m_runNextCount)
+        {
+            for (size_t i = 1; i < m_workerCount; i++)
+            {
+                WorkerSlot &victim = m_workers[(t_worker_index + i) % m_workerCount];
+                if (takeRunNext(victim, kRunNextStealGraceUS, task))
+                {
+                    YBB_TRACE(STEAL, TraceId(task), t_worker_index);
+                    YBB_PROBE3(scheduler__dequeue, TraceId(task), 0, t_worker_index);
+                    ++m_activeThreadCount;
+                    break;
+                }
+            }
+        }
+        // 还有任务，唤醒一下其他的线程
+        if (tickle_me)
+        {
+            tickle();
+        }
+        if (task.coroutine) // task中是协程
+        {
+            // resume返回的时候，已经执行完毕了，所以active--
+            YBB_TRACE(RESUME, task.coroutine->getId(), t_worker_index);
+            beginTask(my_slot, task.coroutine->getId());
+            task.coroutine->resume();
+            my_slot.inTask.store(false, std::memory_order_relaxed);
+            YBB_TRACE(YIELD, task.coroutine->getId(), t_worker_index);
+            --m_activeThreadCount;
+            m_taskCount.inc();
+            task.reset();
+        }
+        else if (task.func) // task中是函数
+        {
+            if (func_coroutine)
+            {
+                func_coroutine->reset(task.func);
+            }
+            else
+            {
+                func_coroutine.reset(new Coroutine(task.func));
+            }
+            task.reset();
+            // 函数任务入队时的追踪id是0，恢复时用同一个id，执行函数的协程是复用的，它的id没有意义
+            YBB_TRACE(RESUME, 0, t_worker_index);
+            beginTask(my_slot, func_coroutine->getId());
+            func_coroutine->resume();
+            my_slot.inTask.store(false, std::memory_order_relaxed);
+            YBB_TRACE(YIELD, 0, t_worker_index);
+            --m_activeThreadCount;
+            m_taskCount.inc();
+            // 函数执行完、没有别人持有时留着给下一个函数任务复用栈；挂起了的协程已经交给了别人
+            if (func_coroutine->getState() != Coroutine::TERM || func_coroutine.use_count() > 1)
+            {
+                func_coroutine.reset();
+            }
+        }
+        else if (task.handle) // task中是无栈协程句柄，直接在调度协程的栈上恢复
+        {
+            std::coroutine_handle<> handle = task.handle;
+            task.reset();
+            YBB_TRACE(RESUME, (uint64_t)(uintptr_t)handle.address(), t_worker_index);
+            beginTask(my_slot, (uint64_t)(uintptr_t)handle.address());
+            handle.resume();
+            my_slot.inTask.store(false, std::memory_order_relaxed);
+            YBB_TRACE(YIELD, (uint64_t)(uintptr_t)handle.address(), t_worker_index);
+            --m_activeThreadCount;
+            m_taskCount.inc();
+        }
+        else // 这里就是任务队列为空，调度idle
+        {
+            if (idle_coroutine->getState() == Coroutine::TERM)
+            {
+                YBB_LOG_DEBUG("idle coroutine term");
+                break;
+            }
+            // 多出来的补充线程和空闲太久的弹性线程让idle协程返回，下一轮退出
+            if (t_worker_kind != STATIC_WORKER && !t_worker_retiring && tryRetire())
+            {
+                t_worker_retiring = true;
+                YBB_LOG_INFO("%s: %s worker %zu retired", m_name.c_str(),
+                             t_worker_kind == ELASTIC_WORKER ? "elastic" : "compensating", t_worker_index);
+            }
+            ++m_idleThreadCount;
+            YBB_TRACE(PARK, 0, t_worker_index);
+            YBB_PROBE1(scheduler__idle__enter, t_worker_index);
+            idle_coroutine->resume();
+            YBB_TRACE(WAKE, 0, t_worker_index);
+            YBB_PROBE1(scheduler__idle__exit, t_worker_index);
+            --m_idleThreadCount;
+        }
+    }
+    if (has_preempt_timer)
+    {
+        timer_delete(preempt_timer);
+    }
+    Rcu::UnregisterThread();
+    releaseSlot(my_slot);
+    // use_caller的线程在run()返回后继续使用本调度器，不能再占着槽
+    t_worker_index = kNoWorker;
+    if (t_worker_kind != STATIC_WORKER)
+    {
+        // 因为调度器停止而退出的，tryRetire()没有扣过计数
+        if (!t_worker_retiring)
+        {
+            --(t_worker_kind == ELASTIC_WORKER ? m_elasticWorkers : m_compensatingWorkers);
+        }
+        retireThread();
+    }
+    YBB_LOG_DEBUG("Scheduler run exit()");
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+size_t BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::claimSlot()
+{
+    for (size_t i = 0; i < m_workerCount; i++)
+    {
+        bool expected = false;
+        if (!m_workers[i].used.load(std::memory_order_relaxed) &&
+            m_workers[i].used.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            return i;
+        }
+    }
+    return m_workerCount;
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::releaseSlot(WorkerSlot &slot)
+{
+    ScheduleTask task;
+    if (takeRunNext(slot, 0, task))
+    {
+        SCOPED_LOCK(MutexType, lock, m_mutex);
+        m_tasks.push_back(task);
+    }
+    slot.inTask.store(false, std::memory_order_relaxed);
+    slot.currentTask.store(0, std::memory_order_relaxed);
+    slot.used.store(false, std::memory_order_release);
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::spawnWorker(bool elastic)
+{
+    std::vector<Thread::ptr> retired;
+    {
+        SCOPED_LOCK(MutexType, lock, m_mutex);
+        // 先回收已经退出的线程，它们的槽位已经归还
+        retired.swap(m_retiredThreads);
+        std::string name;
+        if (elastic)
+        {
+            name = m_name + "_e" + std::to_string(m_scaleUpCount.load());
+            ++m_elasticWorkers;
+        }
+        else
+        {
+            name = m_name + "_c" + std::to_string(m_compensatingSpawned++);
+            ++m_compensatingWorkers;
+        }
+        WorkerKind kind = elastic ? ELASTIC_WORKER : COMPENSATING_WORKER;
+        m_threads.push_back(Thread::ptr(new Thread(
+            [this, kind]() {
+                t_worker_kind = kind;
+                run();
+            },
+            name, m_threadAttr, false)));
+    }
+    for (auto &i : retired)
+    {
+        i->join();
+    }
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::retireThread()
+{
+    // 自己不能join自己，交给下一次spawnWorker()或者stop()
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+    for (auto it = m_threads.begin(); it != m_threads.end(); ++it)
+    {
+        if (it->get() == Thread::GetThis())
+        {
+            m_retiredThreads.push_back(*it);
+            m_threads.erase(it);
+            break;
+        }
+    }
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+bool BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::tryRetire()
+{
+    if (t_worker_kind == COMPENSATING_WORKER)
+    {
+        size_t n = m_compensatingWorkers.load();
+        while (n > m_compensatingTarget.load())
+        {
+            if (m_compensatingWorkers.compare_exchange_weak(n, n - 1))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    uint64_t now = ybb::GetCoarseUS();
+    if (!t_idle_since_us)
+    {
+        t_idle_since_us = now;
+    }
+    if (now - t_idle_since_us < m_elastic.idleMS * 1000)
+    {
+        return false;
+    }
+    // 计数里算着自己，不会减到负数
+    --m_elasticWorkers;
+    ++m_scaleDownCount;
+    size_t depth;
+    {
+        SCOPED_LOCK(MutexType, lock, m_mutex);
+        depth = m_tasks.size();
+    }
+    addScaleEvent(false, depth, now - t_idle_since_us);
+    return true;
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::addScaleEvent(bool up, size_t depth, uint64_t time_to_scale_us)
+{
+    ScaleEvent event;
+    event.up = up;
+    event.timeUS = ybb::GetCurrentUS();
+    event.threads = getThreadCount();
+    event.queueDepth = depth;
+    event.timeToScaleUS = time_to_scale_us;
+    SCOPED_LOCK(MutexType, lock, m_mutex);
+    if (m_scaleEvents.size() >= kMaxScaleEvents)
+    {
+        m_scaleEvents.pop_front();
+    }
+    m_scaleEvents.push_back(event);
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+bool BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::retiring() const
+{
+    return t_worker_retiring;
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::joinWorkers()
+{
+    // 补充线程可能在join的过程中被创建或者退出，直到没有剩下的线程为止
+    while (true)
+    {
+        std::vector<Thread::ptr> thrs;
+        {
+            SCOPED_LOCK(MutexType, lock, m_mutex);
+            thrs.swap(m_threads);
+            thrs.insert(thrs.end(), m_retiredThreads.begin(), m_retiredThreads.end());
+            m_retiredThreads.clear();
+        }
+        if (thrs.empty())
+        {
+            break;
+        }
+        for (auto &i : thrs)
+        {
+            i->join();
+        }
+    }
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::monitor()
+{
+    uint64_t interval_us = UINT64_MAX;
+    if (m_stallMS)
+    {
+        interval_us = m_stallMS * 1000 / 2;
+    }
+    if (m_elasticMax && m_elastic.checkUS < interval_us)
+    {
+        interval_us = m_elastic.checkUS;
+    }
+    interval_us = interval_us ? interval_us : 1;
+    while (!m_monitorSem.waitFor(interval_us))
+    {
+        if (m_stallMS)
+        {
+            checkStalls();
+        }
+        if (m_elasticMax)
+        {
+            checkScaleUp();
+        }
+    }
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::checkScaleUp()
+{
+    if (m_elasticWorkers >= m_elasticMax || m_idleThreadCount > 0)
+    {
+        // 到了上限，或者还有空闲线程，积压不是因为线程不够
+        return;
+    }
+    size_t depth;
+    uint64_t oldest;
+    {
+        SCOPED_LOCK(MutexType, lock, m_mutex);
+        depth = m_tasks.size();
+        oldest = depth ? m_tasks.front().enqueueUS : 0;
+    }
+    uint64_t now = ybb::GetCoarseUS();
+    uint64_t waited = oldest && now > oldest ? now - oldest : 0;
+    bool deep = m_elastic.queueDepth && depth >= m_elastic.queueDepth;
+    bool slow = m_elastic.queueLatencyUS && depth && waited >= m_elastic.queueLatencyUS;
+    if (!deep && !slow)
+    {
+        return;
+    }
+    spawnWorker(true);
+    ++m_scaleUpCount;
+    addScaleEvent(true, depth, waited);
+    YBB_LOG_INFO("%s: scaled up to %zu threads, queue depth %zu, oldest task waited %luus", m_name.c_str(),
+                 getThreadCount(), depth, waited);
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::checkStalls()
+{
+    uint64_t stall_us = m_stallMS * 1000;
+    uint64_t now = ybb::GetCoarseUS();
+    size_t stalled = 0;
+    for (size_t i = 0; i < m_workerCount; i++)
+    {
+        WorkerSlot &slot = m_workers[i];
+        if (!slot.used.load(std::memory_order_acquire))
+        {
+            continue;
+        }
+        uint64_t seq = slot.dispatchSeq.load(std::memory_order_acquire);
+        if (!slot.inTask.load(std::memory_order_relaxed))
+        {
+            continue;
+        }
+        uint64_t id = slot.currentTask.load(std::memory_order_relaxed);
+        uint64_t begin = slot.taskBeginUS.load(std::memory_order_relaxed);
+        // 读的过程中换了任务，这一轮不算
+        if (seq != slot.dispatchSeq.load(std::memory_order_acquire) || now < begin + stall_us)
+        {
+            continue;
+        }
+        ++stalled;
+        if (slot.reportedSeq != seq)
+        {
+            slot.reportedSeq = seq;
+            ++m_stallCount;
+            YBB_LOG_WARN("%s: worker %zu stalled for %lums in coroutine %lu", m_name.c_str(), i,
+                         (now - begin) / 1000, id);
+        }
+    }
+    size_t target = stalled < m_maxCompensating ? stalled : m_maxCompensating;
+    m_compensatingTarget = target;
+    // 任务队列里有任务等着才需要补充线程
+    while (m_compensatingWorkers < target)
+    {
+        {
+            SCOPED_LOCK(MutexType, lock, m_mutex);
+            if (m_tasks.empty() && m_runNextCount == 0)
+            {
+                break;
+            }
+        }
+        spawnWorker(false);
+        YBB_LOG_WARN("%s: spawned compensating worker, %zu stalled", m_name.c_str(), stalled);
+    }
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::stop()
+{
+    YBB_LOG_DEBUG("Scheduler stop");
+    if (stopping())
+    {
+        return;
+    }
+    m_stopping = true;
+
+    /// 如果use caller，那只能由caller线程发起stop
+    if (m_useCaller)
+    {
+        assert(GetThis() == this);
+    }
+    else
+    {
+        assert(GetThis() != this);
+    }
+
+    for (size_t i = 0; i < m_threadCount; i++)
+    {
+        tickle();
+    }
+
+    if (m_scheduleCoroutine)
+    {
+        tickle();
+    }
+
+    /// 在use caller情况下，调度器协程结束时，应该返回caller协程
+    if (m_scheduleCoroutine)
+    {
+        m_scheduleCoroutine->resume();
+        YBB_LOG_DEBUG("m_scheduleCoroutine end");
+    }
+
+    // 只有监控线程会创建补充线程和弹性线程，排空任务的过程中仍然需要它，最后才停掉
+    joinWorkers();
+    if (m_monitor)
+    {
+        m_monitorSem.notify();
+        m_monitor->join();
+        m_monitor.reset();
+        // 监控线程退出前可能又创建了补充线程
+        joinWorkers();
+    }
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::tickle()
+{
+    YBB_PROBE1(scheduler__tickle, (size_t)m_idleThreadCount);
+    YBB_LOG_DEBUG("Scheduler tickle");
+    m_idlePolicy.unpark();
+}
+
+template <template <class> class QueuePolicy, class LockPolicy, class IdlePolicy>
+void BasicScheduler<QueuePolicy, LockPolicy, IdlePolicy>::idle()
+{
+    YBB_LOG_DEBUG("Scheduler idle");
+    while (!stopping() && !retiring())
+    {
+        Coroutine *cur = Coroutine::GetCurrent();
+        cur->setWaitReason("idle");
+        // 忙等策略立即返回，睡眠策略等到tickle或者超时，醒来后回到调度循环检查一遍
+        m_idlePolicy.park(kIdleParkUS);
+        cur->yield();
+    }
+}
+
+#endif
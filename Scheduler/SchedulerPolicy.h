@@ -0,0 +1,195 @@
+/**
+ * @file SchedulerPolicy.h
+ * @brief BasicScheduler的任务队列策略和空闲策略
+ * @details 锁策略直接使用Mutex.h中的锁类型(FutexMutex、Spinlock、NullMutex等)。
+ * 任务队列策略是一个类模板，需要提供push_back/empty/size/front和take：
+ * take(pred, out)从队首开始找第一个满足pred的任务取出，跳过指定给其他线程的任务。
+ * 空闲策略需要提供park(timeout_us)和unpark()：没有任务时idle协程调用park，
+ * 有新任务时tickle调用unpark
+ */
+#ifndef SCHEDULER_POLICY_H
+#define SCHEDULER_POLICY_H
+
+#include "../Mutex/Mutex.h"
+#include <list>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 链表任务队列，默认策略
+ */
+template <class T>
+class ListQueue
+{
+public:
+    void push_back(const T &task) { m_tasks.push_back(task); }
+    bool empty() const { return m_tasks.empty(); }
+    size_t size() const { return m_tasks.size(); }
+    T &front() { return m_tasks.front(); }
+
+    /**
+     * @brief 取出第一个满足pred的任务
+     * @param[in] pred 任务是否可以在当前线程执行
+     * @param[out] out 取出的任务
+     * @param[out] skipped 是否跳过了不满足pred的任务
+     */
+    template <class Pred>
+    bool take(Pred pred, T &out, bool &skipped)
+    {
+        for (auto it = m_tasks.begin(); it != m_tasks.end(); ++it)
+        {
+            if (!pred(*it))
+            {
+                skipped = true;
+                continue;
+            }
+            out = std::move(*it);
+            m_tasks.erase(it);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::list<T> m_tasks;
+};
+
+/**
+ * @brief 环形数组任务队列
+ * @details 连续存储，入队出队不分配内存(满了才翻倍扩容)，
+ * 适合单线程的调度器；取出的不是队首时把前面的任务往后挪一格
+ */
+template <class T>
+class RingQueue
+{
+public:
+    explicit RingQueue(size_t capacity = 64)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_buffer.resize(size);
+    }
+
+    void push_back(const T &task)
+    {
+        if (m_size == m_buffer.size())
+        {
+            grow();
+        }
+        m_buffer[(m_head + m_size) & (m_buffer.size() - 1)] = task;
+        ++m_size;
+    }
+
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+    T &front() { return m_buffer[m_head]; }
+
+    /**
+     * @brief 取出第一个满足pred的任务，参数同ListQueue::take
+     */
+    template <class Pred>
+    bool take(Pred pred, T &out, bool &skipped)
+    {
+        size_t mask = m_buffer.size() - 1;
+        for (size_t i = 0; i < m_size; i++)
+        {
+            T &task = m_buffer[(m_head + i) & mask];
+            if (!pred(task))
+            {
+                skipped = true;
+                continue;
+            }
+            out = std::move(task);
+            // 把前面被跳过的任务往后挪一格，填上空位
+            for (size_t j = i; j > 0; j--)
+            {
+                m_buffer[(m_head + j) & mask] = std::move(m_buffer[(m_head + j - 1) & mask]);
+            }
+            m_buffer[m_head] = T();
+            m_head = (m_head + 1) & mask;
+            --m_size;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    void grow()
+    {
+        std::vector<T> buffer(m_buffer.size() * 2);
+        for (size_t i = 0; i < m_size; i++)
+        {
+            buffer[i] = std::move(m_buffer[(m_head + i) & (m_buffer.size() - 1)]);
+        }
+        m_buffer.swap(buffer);
+        m_head = 0;
+    }
+
+private:
+    std::vector<T> m_buffer;
+    size_t m_head = 0;
+    size_t m_size = 0;
+};
+
+/**
+ * @brief 空闲时忙等，默认策略
+ * @details idle协程让出后调度循环马上再检查一遍任务队列，响应最快，但空闲线程占满CPU
+ */
+struct SpinIdle
+{
+    void park(uint64_t) {}
+    void unpark() {}
+};
+
+/**
+ * @brief 空闲时在futex上睡眠
+ * @details 有新任务时tickle唤醒一个空闲线程；睡眠带超时，
+ * 定时任务、fd任务和run-next槽的偷取靠超时醒来后的那一轮检查。
+ * 只有登记过正在睡眠的线程时才释放信号量，每次释放认领一个登记，
+ * 没有线程睡眠时的tickle不会攒下信号量让之后的park空转
+ */
+struct FutexIdle
+{
+    void park(uint64_t timeout_us)
+    {
+        m_parked.fetch_add(1, std::memory_order_seq_cst);
+        if (m_sem.waitFor(timeout_us))
+        {
+            return;
+        }
+        // 超时，撤销登记；登记已经被unpark认领时，它释放的信号量归自己
+        if (!claim())
+        {
+            m_sem.wait();
+        }
+    }
+
+    void unpark()
+    {
+        if (claim())
+        {
+            m_sem.notify();
+        }
+    }
+
+    /**
+     * @brief 认领一个睡眠登记，没有登记时返回false
+     */
+    bool claim()
+    {
+        size_t n = m_parked.load(std::memory_order_seq_cst);
+        while (n && !m_parked.compare_exchange_weak(n, n - 1, std::memory_order_seq_cst))
+        {
+        }
+        return n != 0;
+    }
+
+    // 登记了、还没被认领的睡眠线程数
+    std::atomic<size_t> m_parked = {0};
+    Semaphore m_sem;
+};
+
+#endif
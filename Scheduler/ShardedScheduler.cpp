@@ -0,0 +1,380 @@
+#include "ShardedScheduler.h"
+#include "Scheduler.h"
+#include "../Log/Log.h"
+#include <assert.h>
+#include <sched.h>
+
+// 当前线程所在的分片调度器和分片号
+static thread_local ShardedScheduler *t_sharded = nullptr;
+static thread_local int t_shard_id = -1;
+
+// 没有任务时最多睡眠这么久(微秒)，溢出队列之外的任务都会主动唤醒，定时任务靠醒来后的那一轮检查
+static const uint64_t kIdleSleepUS = 1000;
+
+/**
+ * @brief 分片线程上的单线程调度器
+ * @details 任务队列不加锁，只有分片线程入队；其他线程放回协程时改为放入分片的就绪列表，
+ * 所以blocking()和switchTo()在分片上也能用
+ */
+class ShardedScheduler::ShardLoop : public BasicScheduler<RingQueue, NullMutex, SpinIdle>
+{
+public:
+    ShardLoop(ShardedScheduler &owner, Shard &shard, const std::string &name)
+        : BasicScheduler(1, true, name), m_owner(owner), m_shard(shard)
+    {
+        m_remoteEnqueue = true;
+    }
+
+    void scheduleCoroutine(Coroutine::ptr co, int thread) override
+    {
+        if (t_scheduler == this)
+        {
+            schedule(co, thread);
+            return;
+        }
+        m_owner.putBack(m_shard, co);
+    }
+
+private:
+    ShardedScheduler &m_owner;
+    Shard &m_shard;
+};
+
+ShardedScheduler::Shard::Shard(size_t shards, size_t ring_capacity)
+    : overflow(shards)
+{
+    for (size_t i = 0; i <= shards; i++)
+    {
+        inbound.emplace_back(new SpscRing<Task>(ring_capacity));
+    }
+}
+
+ShardedScheduler::ShardedScheduler(size_t shards, const std::string &name, bool pin, size_t ring_capacity)
+    : m_name(name), m_pin(pin)
+{
+    assert(shards > 0);
+    for (size_t i = 0; i < shards; i++)
+    {
+        m_shards.emplace_back(new Shard(shards, ring_capacity));
+    }
+}
+
+ShardedScheduler::~ShardedScheduler()
+{
+    stop();
+}
+
+ShardedScheduler *ShardedScheduler::GetThis()
+{
+    return t_sharded;
+}
+
+int ShardedScheduler::GetShardId()
+{
+    return t_shard_id;
+}
+
+void ShardedScheduler::start()
+{
+    if (m_started)
+    {
+        return;
+    }
+    m_started = true;
+    // 按可用CPU集合编号绑定，容器和taskset限制下也不会绑到不能用的CPU上
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    if (m_pin && sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        for (int i = 0; i < CPU_SETSIZE; i++)
+        {
+            if (CPU_ISSET(i, &allowed))
+            {
+                cpus.push_back(i);
+            }
+        }
+    }
+    for (size_t i = 0; i < m_shards.size(); i++)
+    {
+        ThreadAttr attr;
+        if (!cpus.empty())
+        {
+            attr.cpu = cpus[i % cpus.size()];
+        }
+        m_shards[i]->thread.reset(new Thread(std::bind(&ShardedScheduler::run, this, i),
+                                             m_name + '_' + std::to_string(i), attr, false));
+    }
+    for (auto &i : m_shards)
+    {
+        i->thread->waitStarted();
+    }
+}
+
+void ShardedScheduler::stop()
+{
+    if (!m_started || m_stopped)
+    {
+        return;
+    }
+    // 分片线程等不到所有分片都空闲
+    assert(GetThis() != this);
+    m_stopped = true;
+    while (!quiescent())
+    {
+        usleep(100);
+    }
+    m_exit = true;
+    for (auto &i : m_shards)
+    {
+        i->wakeup.notify();
+    }
+    for (auto &i : m_shards)
+    {
+        i->thread->join();
+    }
+}
+
+void ShardedScheduler::post(size_t shard_id, Task task)
+{
+    assert(shard_id < m_shards.size());
+    Shard &target = *m_shards[shard_id];
+    task = track(std::move(task));
+    if (t_sharded == this)
+    {
+        Shard &self = *m_shards[t_shard_id];
+        // 先计数再入队，stop()据此判断有没有任务在路上
+        self.sent.store(self.sent.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        if ((size_t)t_shard_id == shard_id)
+        {
+            self.scheduler->schedule(std::move(task));
+            return;
+        }
+        // 溢出队列里还有任务时继续排在后面，保持同一对分片之间的顺序
+        std::deque<Task> &overflow = self.overflow[shard_id];
+        if (!overflow.empty() || !target.inbound[t_shard_id]->push(std::move(task)))
+        {
+            overflow.push_back(std::move(task));
+            ++self.overflowSize;
+            self.overflowCount.store(self.overflowCount.load(std::memory_order_relaxed) + 1,
+                                     std::memory_order_relaxed);
+            return;
+        }
+    }
+    else
+    {
+        Spinlock::Lock lock(target.externalLock);
+        ++m_externalSent;
+        while (!target.inbound.back()->push(std::move(task)))
+        {
+            // 外部线程不是分片，可以等
+            wake(target);
+            sched_yield();
+        }
+    }
+    wake(target);
+}
+
+void ShardedScheduler::wake(Shard &shard)
+{
+    // 与分片进入睡眠前的sleeping写入、检查入队环配对，保证不会两边都没看到对方
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (shard.sleeping.load(std::memory_order_relaxed) && shard.sleeping.exchange(false))
+    {
+        shard.wakeup.notify();
+    }
+}
+
+ShardedScheduler::Task ShardedScheduler::track(Task task)
+{
+    return [this, task = std::move(task)]() {
+        task();
+        if (t_sharded == this)
+        {
+            Shard &self = *m_shards[t_shard_id];
+            self.executed.store(self.executed.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        else
+        {
+            // 任务迁出了分片，在其他线程上执行完
+            ++m_externalExecuted;
+        }
+    };
+}
+
+void ShardedScheduler::putBack(Shard &shard, Coroutine::ptr co)
+{
+    {
+        Spinlock::Lock lock(shard.readyLock);
+        shard.ready.push_back(std::move(co));
+        shard.hasReady.store(true);
+    }
+    wake(shard);
+}
+
+size_t ShardedScheduler::pollInbound(Shard &shard)
+{
+    size_t total = 0;
+    for (auto &ring : shard.inbound)
+    {
+        Task task;
+        size_t n = 0;
+        while (n < kBatchSize && ring->pop(task))
+        {
+            shard.scheduler->schedule(std::move(task));
+            ++n;
+        }
+        total += n;
+    }
+    if (total)
+    {
+        shard.remote.store(shard.remote.load(std::memory_order_relaxed) + total, std::memory_order_relaxed);
+    }
+    if (shard.hasReady.load(std::memory_order_acquire))
+    {
+        std::vector<Coroutine::ptr> ready;
+        {
+            Spinlock::Lock lock(shard.readyLock);
+            ready.swap(shard.ready);
+            shard.hasReady.store(false, std::memory_order_relaxed);
+        }
+        for (auto &i : ready)
+        {
+            shard.scheduler->schedule(i);
+        }
+        total += ready.size();
+    }
+    return total;
+}
+
+void ShardedScheduler::flushOverflow(size_t index, Shard &shard)
+{
+    for (size_t i = 0; i < shard.overflow.size(); i++)
+    {
+        std::deque<Task> &overflow = shard.overflow[i];
+        if (overflow.empty())
+        {
+            continue;
+        }
+        Shard &target = *m_shards[i];
+        while (!overflow.empty() && target.inbound[index]->push(std::move(overflow.front())))
+        {
+            overflow.pop_front();
+            --shard.overflowSize;
+        }
+        wake(target);
+    }
+}
+
+bool ShardedScheduler::hasWork(Shard &shard) const
+{
+    if (shard.overflowSize || shard.hasReady.load())
+    {
+        return true;
+    }
+    for (auto &ring : shard.inbound)
+    {
+        if (!ring->empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ShardedScheduler::quiescent() const
+{
+    // 先读执行数再读投递数：执行过的任务一定已经计入投递数，两者相等说明没有任务在路上
+    uint64_t executed = m_externalExecuted.load(), sent = 0;
+    for (auto &i : m_shards)
+    {
+        executed += i->executed.load();
+    }
+    for (auto &i : m_shards)
+    {
+        sent += i->sent.load();
+    }
+    sent += m_externalSent.load();
+    return executed == sent;
+}
+
+void ShardedScheduler::run(size_t index)
+{
+    t_sharded = this;
+    t_shard_id = index;
+    Shard &shard = *m_shards[index];
+    {
+        ShardLoop loop(*this, shard, m_name + '_' + std::to_string(index));
+        shard.scheduler = &loop;
+        loop.schedule(Coroutine::ptr(new Coroutine(std::bind(&ShardedScheduler::pump, this, index))));
+        loop.start();
+        // use_caller的调度器在stop()里执行调度循环，泵协程退出、剩下的任务(比如定时任务)执行完才返回
+        loop.stop();
+        shard.scheduler = nullptr;
+    }
+    YBB_LOG_DEBUG("%s shard %zu exit", m_name.c_str(), index);
+    t_sharded = nullptr;
+    t_shard_id = -1;
+}
+
+void ShardedScheduler::pump(size_t index)
+{
+    Shard &shard = *m_shards[index];
+    while (true)
+    {
+        size_t n = pollInbound(shard);
+        if (shard.overflowSize)
+        {
+            flushOverflow(index, shard);
+        }
+        // 任务队列里除了泵协程自己什么也没有
+        if (!n && shard.scheduler->getQueueSize() == 0)
+        {
+            // 所有投递的任务都执行完了，但分片调度器上可能还有任务自己创建的协程在等定时器或者阻塞调用，
+            // 它们回来时还要经过就绪列表，泵协程要等到它们都结束
+            ShardLoop &loop = *shard.scheduler;
+            if (m_exit && !hasWork(shard) && !loop.getPendingCount() && !loop.getBlockingCount() &&
+                !loop.getAwayCount())
+            {
+                break;
+            }
+            shard.sleeping.store(true);
+            if (!hasWork(shard))
+            {
+                shard.wakeup.waitFor(kIdleSleepUS);
+            }
+            shard.sleeping.store(false);
+        }
+        // 排到队尾，先执行这一轮取到的任务和本地任务，入队环不会被饿着
+        Coroutine::GetThis()->reschedule();
+    }
+}
+
+uint64_t ShardedScheduler::getTaskCount() const
+{
+    uint64_t total = m_externalExecuted.load();
+    for (auto &i : m_shards)
+    {
+        total += i->executed.load();
+    }
+    return total;
+}
+
+uint64_t ShardedScheduler::getRemoteTaskCount() const
+{
+    uint64_t total = 0;
+    for (auto &i : m_shards)
+    {
+        total += i->remote.load();
+    }
+    return total;
+}
+
+uint64_t ShardedScheduler::getOverflowCount() const
+{
+    uint64_t total = 0;
+    for (auto &i : m_shards)
+    {
+        total += i->overflowCount.load();
+    }
+    return total;
+}
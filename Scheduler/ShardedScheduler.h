@@ -0,0 +1,236 @@
+/**
+ * @file ShardedScheduler.h
+ * @brief 每核一个线程的分片调度器
+ * @details 与共享任务队列的Scheduler不同，每个分片是一个绑定CPU的单线程调度器
+ * BasicScheduler<RingQueue, NullMutex, SpinIdle>，分片内的任务队列只有自己访问，入队出队不加锁。
+ * 分片之间只通过SPSC环形队列通信：每个分片为其他每个分片准备一个入队环，
+ * 再加一个给非分片线程使用的入队环(生产者一侧用自旋锁串行化)；
+ * 每个分片有一个常驻的泵协程，按批从所有入队环取任务放进分片的调度器，然后让出排到队尾，
+ * 本地任务和远端任务轮流执行。目标环满时，分片把任务暂存在自己的溢出队列里，
+ * 下一轮再发，不会因为两个分片互相等待而死锁。
+ * 任务在分片调度器的协程中执行，可以让出、sleep_for、blocking()，也可以用switchTo()迁出再迁回：
+ * 其他线程把协程放回分片时经过一个加锁的就绪列表，由泵协程放入任务队列。
+ * 适合无共享的服务：数据按分片划分，跨分片访问改成submit_to(shard, f)把计算送到数据所在的分片
+ */
+#ifndef __SHARDED_SCHEDULER_H__
+#define __SHARDED_SCHEDULER_H__
+
+#include "../Coroutine/Coroutine.h"
+#include "../Mutex/Mutex.h"
+#include "../Mutex/SpscRing.h"
+#include "../Thread/Threads.h"
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief 分片调度器
+ */
+class ShardedScheduler : Noncopyable
+{
+public:
+    typedef std::shared_ptr<ShardedScheduler> ptr;
+    typedef std::function<void()> Task;
+
+    /// 泵协程每一轮从一个入队环最多取的任务数
+    static const size_t kBatchSize = 64;
+
+    /**
+     * @brief 构造函数
+     * @param[in] shards 分片数，即线程数
+     * @param[in] name 名称，线程名为name_分片号
+     * @param[in] pin 是否把分片i绑定到第i个可用CPU上(超过CPU数时取模)
+     * @param[in] ring_capacity 每个入队环的容量
+     */
+    ShardedScheduler(size_t shards, const std::string &name = "Sharded", bool pin = true,
+                     size_t ring_capacity = 1024);
+
+    /**
+     * @brief 析构函数，没有stop()时自动stop()
+     */
+    ~ShardedScheduler();
+
+    /**
+     * @brief 启动所有分片
+     */
+    void start();
+
+    /**
+     * @brief 等所有任务(包括任务中继续提交的任务)都执行完，停止所有分片
+     */
+    void stop();
+
+    /**
+     * @brief 分片数
+     */
+    size_t getShardCount() const { return m_shards.size(); }
+
+    /**
+     * @brief 获取名称
+     */
+    const std::string &getName() const { return m_name; }
+
+    /**
+     * @brief 当前线程所在的分片调度器，不是分片线程时返回nullptr
+     */
+    static ShardedScheduler *GetThis();
+
+    /**
+     * @brief 当前线程的分片号，不是分片线程时返回-1
+     */
+    static int GetShardId();
+
+    /**
+     * @brief 把任务投递到指定分片，不关心结果
+     * @details 在分片线程上投递给自己时直接放入分片的调度器
+     */
+    void post(size_t shard, Task task);
+
+    /**
+     * @brief 在指定分片上执行f，通过future拿结果
+     * @details 在分片线程上等future会卡住这个分片，分片之间应该用post()回传结果
+     */
+    template <class F>
+    std::future<std::invoke_result_t<F>> submit_to(size_t shard, F f)
+    {
+        typedef std::invoke_result_t<F> R;
+        std::shared_ptr<std::promise<R>> promise = std::make_shared<std::promise<R>>();
+        std::future<R> future = promise->get_future();
+        post(shard, [promise, f = std::move(f)]() mutable {
+            try
+            {
+                if constexpr (std::is_void_v<R>)
+                {
+                    f();
+                    promise->set_value();
+                }
+                else
+                {
+                    promise->set_value(f());
+                }
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        return future;
+    }
+
+    /**
+     * @brief 已经执行完的任务数
+     */
+    uint64_t getTaskCount() const;
+
+    /**
+     * @brief 经过入队环的任务数(跨分片和外部线程投递的任务)
+     */
+    uint64_t getRemoteTaskCount() const;
+
+    /**
+     * @brief 因为目标环满而进入溢出队列的次数
+     */
+    uint64_t getOverflowCount() const;
+
+private:
+    /// 分片线程上的调度器，定义在ShardedScheduler.cpp中
+    class ShardLoop;
+
+    /**
+     * @brief 一个分片
+     */
+    struct alignas(kCacheLineSize) Shard
+    {
+        Shard(size_t shards, size_t ring_capacity);
+
+        // 分片线程上的调度器，只由本分片线程访问
+        ShardLoop *scheduler = nullptr;
+        // 入队环，inbound[i]的生产者是分片i，最后一个给外部线程
+        std::vector<std::unique_ptr<SpscRing<Task>>> inbound;
+        // 外部线程之间串行化inbound.back()的生产者一侧
+        Spinlock externalLock;
+        // 发往各分片时环满暂存的任务，只由本分片线程访问
+        std::vector<std::deque<Task>> overflow;
+        size_t overflowSize = 0;
+        // 其他线程放回来的协程(blocking()完成、switchTo()迁入)
+        Spinlock readyLock;
+        std::vector<Coroutine::ptr> ready;
+        std::atomic<bool> hasReady = {false};
+        // 分片线程在睡眠，生产者入队后需要唤醒
+        std::atomic<bool> sleeping = {false};
+        Semaphore wakeup;
+        // 本分片投递出去的任务数和在本分片上执行完的任务数，只由本分片线程写
+        std::atomic<uint64_t> sent = {0};
+        std::atomic<uint64_t> executed = {0};
+        std::atomic<uint64_t> remote = {0};
+        std::atomic<uint64_t> overflowCount = {0};
+        Thread::ptr thread;
+    };
+
+    /**
+     * @brief 分片线程主函数
+     */
+    void run(size_t index);
+
+    /**
+     * @brief 泵协程：把入队环和就绪列表中的任务放进分片的调度器，没有任务时睡眠
+     */
+    void pump(size_t index);
+
+    /**
+     * @brief 取出所有入队环中的任务，每个环最多kBatchSize个，以及就绪列表中的协程，放进分片的调度器
+     * @return 取到的任务数
+     */
+    size_t pollInbound(Shard &shard);
+
+    /**
+     * @brief 投递的任务外面包一层，执行完时计数
+     */
+    Task track(Task task);
+
+    /**
+     * @brief 其他线程把协程放回分片
+     */
+    void putBack(Shard &shard, Coroutine::ptr co);
+
+    /**
+     * @brief 重发溢出队列中的任务
+     */
+    void flushOverflow(size_t index, Shard &shard);
+
+    /**
+     * @brief 入队后唤醒睡眠的分片
+     */
+    void wake(Shard &shard);
+
+    /**
+     * @brief 所有投递过的任务都已经执行完
+     */
+    bool quiescent() const;
+
+    /**
+     * @brief 分片上是否还有任务
+     */
+    bool hasWork(Shard &shard) const;
+
+private:
+    std::string m_name;
+    bool m_pin;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    // 外部线程投递的任务数
+    std::atomic<uint64_t> m_externalSent = {0};
+    // 迁出分片后在其他线程上执行完的任务数
+    std::atomic<uint64_t> m_externalExecuted = {0};
+    // 分片可以退出
+    std::atomic<bool> m_exit = {false};
+    bool m_started = false;
+    bool m_stopped = false;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "Task.h"
+#include <stdlib.h>
+
+// 分级粒度
+static const size_t kFrameGranularity = 64;
+// 参与回收的最大帧大小，更大的直接malloc
+static const size_t kMaxCachedFrameSize = 4096;
+// 每一级最多缓存的空闲帧数量
+static const size_t kMaxCachedFrames = 256;
+
+namespace
+{
+    /**
+     * @brief 线程局部的协程帧空闲链表
+     */
+    struct FrameCache
+    {
+        struct FreeNode
+        {
+            FreeNode *next;
+        };
+
+        FreeNode *heads[kMaxCachedFrameSize / kFrameGranularity] = {nullptr};
+        size_t counts[kMaxCachedFrameSize / kFrameGranularity] = {0};
+
+        ~FrameCache()
+        {
+            for (auto head : heads)
+            {
+                while (head)
+                {
+                    FreeNode *next = head->next;
+                    free(head);
+                    head = next;
+                }
+            }
+        }
+    };
+
+    thread_local FrameCache t_frame_cache;
+
+    size_t SizeClass(size_t size)
+    {
+        return (size + kFrameGranularity - 1) / kFrameGranularity - 1;
+    }
+}
+
+void *FrameAllocator::Allocate(size_t size)
+{
+    if (size > kMaxCachedFrameSize)
+    {
+        void *ptr = malloc(size);
+        if (ptr == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+    size_t cls = SizeClass(size);
+    FrameCache::FreeNode *node = t_frame_cache.heads[cls];
+    if (node)
+    {
+        t_frame_cache.heads[cls] = node->next;
+        --t_frame_cache.counts[cls];
+        return node;
+    }
+    // 按级别的上限分配，回收后同一级别的帧可以互相复用
+    void *ptr = malloc((cls + 1) * kFrameGranularity);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void FrameAllocator::Deallocate(void *ptr, size_t size)
+{
+    if (size > kMaxCachedFrameSize)
+    {
+        free(ptr);
+        return;
+    }
+    size_t cls = SizeClass(size);
+    // task可能在别的工作线程上结束，帧放入结束时所在线程的缓存
+    if (t_frame_cache.counts[cls] >= kMaxCachedFrames)
+    {
+        free(ptr);
+        return;
+    }
+    FrameCache::FreeNode *node = static_cast<FrameCache::FreeNode *>(ptr);
+    node->next = t_frame_cache.heads[cls];
+    t_frame_cache.heads[cls] = node;
+    ++t_frame_cache.counts[cls];
+}
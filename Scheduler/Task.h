@@ -0,0 +1,261 @@
+#ifndef TASK_H
+#define TASK_H
+/**
+ * @brief C++20无栈协程task<T>
+ * @details task<T>与有栈的Coroutine共用Scheduler的工作线程和任务队列，
+ * 协程帧由按大小分级的线程局部空闲链表回收复用，
+ * 短小的异步调用链可以用task<T>代替Coroutine，省去每个协程一份栈的开销
+ */
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <stddef.h>
+#include "Scheduler.h"
+
+/**
+ * @brief 协程帧分配器
+ * @details 按64字节分级，每个线程缓存一定数量的空闲帧，超过上限或过大的帧直接走malloc/free
+ */
+class FrameAllocator
+{
+public:
+    /**
+     * @brief 分配协程帧
+     * @param[in] size 帧大小
+     */
+    static void *Allocate(size_t size);
+
+    /**
+     * @brief 归还协程帧，放回当前线程的空闲链表
+     * @param[in] ptr 帧地址
+     * @param[in] size 帧大小，必须与分配时一致
+     */
+    static void Deallocate(void *ptr, size_t size);
+};
+
+template <class T = void>
+class task;
+
+namespace detail
+{
+    /**
+     * @brief task promise的公共部分：帧分配、延续协程、异常
+     */
+    struct TaskPromiseBase
+    {
+        // 等待本task完成的协程，完成时对称切换过去
+        std::coroutine_handle<> continuation;
+        // 协程体抛出的异常
+        std::exception_ptr exception;
+        // 是否已经脱离task对象，由调度器直接驱动
+        bool detached = false;
+
+        static void *operator new(size_t size) { return FrameAllocator::Allocate(size); }
+        static void operator delete(void *ptr, size_t size) { FrameAllocator::Deallocate(ptr, size); }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+
+            template <class P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+            {
+                TaskPromiseBase &promise = h.promise();
+                if (promise.continuation)
+                {
+                    return promise.continuation;
+                }
+                if (promise.detached)
+                {
+                    h.destroy();
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        // task是惰性的，创建后先挂起，被co_await或者spawn时才开始执行
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+
+        void unhandled_exception()
+        {
+            // 脱离的task没有人取结果，异常直接抛给调度循环，和有栈协程的行为一致
+            if (detached)
+            {
+                throw;
+            }
+            exception = std::current_exception();
+        }
+    };
+
+    template <class T>
+    struct TaskPromise : TaskPromiseBase
+    {
+        std::optional<T> value;
+
+        task<T> get_return_object();
+
+        template <class U>
+        void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+
+        T result()
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+            return std::move(*value);
+        }
+    };
+
+    template <>
+    struct TaskPromise<void> : TaskPromiseBase
+    {
+        task<void> get_return_object();
+
+        void return_void() {}
+
+        void result()
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+    };
+}
+
+/**
+ * @brief 无栈协程任务
+ * @details co_await一个task会启动它，并在它结束时通过对称转移直接切回等待者，
+ * 顶层的task<void>用spawn()交给调度器
+ */
+template <class T>
+class task
+{
+public:
+    typedef detail::TaskPromise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> handle_type;
+
+    explicit task(handle_type h) : m_handle(h) {}
+
+    task(task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+    task &operator=(task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+            }
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+
+    ~task()
+    {
+        if (m_handle)
+        {
+            m_handle.destroy();
+        }
+    }
+
+    /**
+     * @brief 是否已经执行结束
+     */
+    bool done() const { return !m_handle || m_handle.done(); }
+
+    struct Awaiter
+    {
+        handle_type handle;
+
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+        {
+            handle.promise().continuation = caller;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().result(); }
+    };
+
+    Awaiter operator co_await() const noexcept { return Awaiter{m_handle}; }
+
+    /**
+     * @brief 放弃对协程帧的所有权，协程结束时自行销毁
+     */
+    std::coroutine_handle<> detach()
+    {
+        m_handle.promise().detached = true;
+        return std::exchange(m_handle, nullptr);
+    }
+
+private:
+    handle_type m_handle;
+};
+
+namespace detail
+{
+    template <class T>
+    task<T> TaskPromise<T>::get_return_object()
+    {
+        return task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline task<void> TaskPromise<void>::get_return_object()
+    {
+        return task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+}
+
+/**
+ * @brief 把顶层task交给调度器执行
+ * @param[in] t 要执行的task，调度器接管其协程帧
+ * @param[in] scheduler 调度器，默认为当前线程的调度器
+ * @param[in] thread 指定执行的线程号，-1为任意线程
+ */
+inline void spawn(task<void> t, SchedulerBase *scheduler = SchedulerBase::GetThis(), int thread = -1)
+{
+    scheduler->scheduleHandle(t.detach(), thread);
+}
+
+/**
+ * @brief co_await sleep_for(ms)，挂起当前task，到期后由当前调度器重新调度
+ */
+struct sleep_for
+{
+    explicit sleep_for(uint64_t ms) : m_ms(ms) {}
+
+    bool await_ready() const noexcept { return m_ms == 0; }
+    void await_suspend(std::coroutine_handle<> h) { SchedulerBase::GetThis()->scheduleAfter(h, m_ms, -1); }
+    void await_resume() const noexcept {}
+
+private:
+    uint64_t m_ms;
+};
+
+/**
+ * @brief co_await fd_readable(fd)，挂起当前task，fd可读后由当前调度器重新调度
+ */
+struct fd_readable
+{
+    explicit fd_readable(int fd) : m_fd(fd) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) { SchedulerBase::GetThis()->scheduleOnReadable(m_fd, h, -1); }
+    void await_resume() const noexcept {}
+
+private:
+    int m_fd;
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "TaskGraph.h"
+#include "../Log/Log.h"
+#include <algorithm>
+#include <assert.h>
+#include <stdexcept>
+
+TaskGraph::TaskGraph(const std::string &name)
+    : m_name(name)
+{
+}
+
+TaskGraph::NodeId TaskGraph::addNode(std::function<void()> func, const std::string &name)
+{
+    assert(!m_scheduler);
+    m_nodes.emplace_back();
+    Node &node = m_nodes.back();
+    node.func = std::move(func);
+    node.name = name.empty() ? "node" + std::to_string(m_nodes.size() - 1) : name;
+    m_dirty = true;
+    return m_nodes.size() - 1;
+}
+
+void TaskGraph::addEdge(NodeId before, NodeId after)
+{
+    assert(!m_scheduler);
+    assert(before < m_nodes.size() && after < m_nodes.size() && before != after);
+    m_nodes[before].successors.push_back(after);
+    ++m_nodes[after].predecessors;
+    m_dirty = true;
+}
+
+void TaskGraph::prepare()
+{
+    size_t n = m_nodes.size();
+    m_order.clear();
+    m_roots.clear();
+    m_order.reserve(n);
+    std::vector<size_t> indegree(n);
+    for (NodeId i = 0; i < n; i++)
+    {
+        indegree[i] = m_nodes[i].predecessors;
+        if (!indegree[i])
+        {
+            m_roots.push_back(i);
+            m_order.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < m_order.size(); i++)
+    {
+        for (NodeId s : m_nodes[m_order[i]].successors)
+        {
+            if (--indegree[s] == 0)
+            {
+                m_order.push_back(s);
+            }
+        }
+    }
+    if (m_order.size() != n)
+    {
+        throw std::logic_error(m_name + ": task graph has a cycle");
+    }
+    // 关键路径最多经过所有节点，之后每次执行不再扩容
+    m_lastRun.criticalPath.reserve(n);
+    m_dirty = false;
+}
+
+void TaskGraph::run(SchedulerBase &scheduler)
+{
+    // 同一个图不能同时执行多次
+    assert(!m_scheduler);
+    if (m_dirty)
+    {
+        prepare();
+    }
+    uint64_t begin = ybb::GetCurrentUS();
+    ++m_runCount;
+    if (m_nodes.empty())
+    {
+        collectStats(begin);
+        return;
+    }
+    m_scheduler = &scheduler;
+    for (auto &i : m_nodes)
+    {
+        i.pending.store(i.predecessors, std::memory_order_relaxed);
+    }
+    m_remaining.store(m_nodes.size(), std::memory_order_relaxed);
+    m_failed.store(false, std::memory_order_relaxed);
+    m_error = nullptr;
+    m_inlineCount.store(0, std::memory_order_relaxed);
+    m_joinState.store(JOIN_RUNNING);
+    Coroutine *co = SchedulerBase::GetTaskCoroutine();
+    m_waitOnFutex = !co;
+
+    for (NodeId root : m_roots)
+    {
+        scheduler.scheduleFunction([this, root]() { execute(root); }, -1);
+    }
+    if (co)
+    {
+        co->setWaitReason("task graph");
+        // 切换完成后才登记，最后一个节点完成时据此决定由谁把协程放回调度器
+        co->suspend([this](Coroutine::ptr self) {
+            m_waiter = self;
+            int expected = JOIN_RUNNING;
+            if (!m_joinState.compare_exchange_strong(expected, JOIN_PARKED))
+            {
+                // 挂起之前所有节点已经完成
+                m_waiter.reset();
+                SchedulerBase::GetThis()->scheduleCoroutine(self, -1);
+            }
+        });
+    }
+    else
+    {
+        int expected = JOIN_RUNNING;
+        if (m_joinState.compare_exchange_strong(expected, JOIN_PARKED))
+        {
+            while (m_joinState.load(std::memory_order_acquire) != JOIN_DONE)
+            {
+                FutexWait(&m_joinState, JOIN_PARKED);
+            }
+        }
+    }
+    m_scheduler = nullptr;
+    collectStats(begin);
+    YBB_LOG_DEBUG("%s: run %lu took %luus, critical path %luus over %zu nodes, %zu inline", m_name.c_str(),
+                  m_runCount, m_lastRun.wallUS, m_lastRun.criticalPathUS, m_lastRun.criticalPath.size(),
+                  m_lastRun.inlineCount);
+    if (m_error)
+    {
+        std::rethrow_exception(m_error);
+    }
+}
+
+void TaskGraph::execute(NodeId id)
+{
+    while (true)
+    {
+        Node &node = m_nodes[id];
+        node.beginUS = ybb::GetCurrentUS();
+        if (!m_failed.load(std::memory_order_relaxed))
+        {
+            try
+            {
+                node.func();
+            }
+            catch (...)
+            {
+                Spinlock::Lock lock(m_errorLock);
+                if (!m_error)
+                {
+                    m_error = std::current_exception();
+                }
+                m_failed = true;
+            }
+        }
+        node.endUS = ybb::GetCurrentUS();
+
+        // 第一个就绪的后继留给自己，其余的放入任务队列让其他线程执行
+        NodeId next = kNoNode;
+        for (NodeId s : node.successors)
+        {
+            if (m_nodes[s].pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            {
+                continue;
+            }
+            if (next == kNoNode)
+            {
+                next = s;
+            }
+            else
+            {
+                m_scheduler->scheduleFunction([this, s]() { execute(s); }, -1);
+            }
+        }
+        if (next != kNoNode)
+        {
+            ++m_inlineCount;
+        }
+        // 没有就绪的后继时，这可能是最后一个节点，之后不能再访问this
+        finishNode();
+        if (next == kNoNode)
+        {
+            return;
+        }
+        id = next;
+    }
+}
+
+void TaskGraph::finishNode()
+{
+    if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    // 线程等待时，换成JOIN_DONE之后run()随时可能返回、图随时可能析构，
+    // 交换之后只用提前取好的地址唤醒：futex唤醒不读写这块内存，地址失效时内核返回错误
+    std::atomic<int> *state = &m_joinState;
+    bool on_futex = m_waitOnFutex;
+    if (state->exchange(JOIN_DONE) != JOIN_PARKED)
+    {
+        return;
+    }
+    if (on_futex)
+    {
+        FutexWake(state, 1);
+        return;
+    }
+    // 协程等待时，放回调度器之前它不会恢复
+    Coroutine::ptr waiter;
+    waiter.swap(m_waiter);
+    waiter->getScheduler()->scheduleCoroutine(waiter, -1);
+}
+
+void TaskGraph::collectStats(uint64_t begin_us)
+{
+    RunStats &stats = m_lastRun;
+    stats.criticalPath.clear();
+    stats.workUS = 0;
+    stats.criticalPathUS = 0;
+    stats.inlineCount = m_inlineCount.load(std::memory_order_relaxed);
+    uint64_t end_us = begin_us;
+    for (NodeId id : m_order)
+    {
+        Node &node = m_nodes[id];
+        node.pathUS = node.endUS - node.beginUS;
+        node.pathPrev = kNoNode;
+        stats.workUS += node.pathUS;
+        end_us = std::max(end_us, node.endUS);
+    }
+    stats.wallUS = end_us - begin_us;
+    if (m_order.empty())
+    {
+        return;
+    }
+    // 按拓扑序松弛，处理到一个节点时它的所有前驱都已经处理过
+    NodeId last = m_order[0];
+    for (NodeId id : m_order)
+    {
+        Node &node = m_nodes[id];
+        for (NodeId s : node.successors)
+        {
+            Node &succ = m_nodes[s];
+            uint64_t path = node.pathUS + (succ.endUS - succ.beginUS);
+            // 有前驱的节点总要接在某个前驱后面，耗时为0的节点也算在链上
+            if (succ.pathPrev == kNoNode || path > succ.pathUS)
+            {
+                succ.pathUS = path;
+                succ.pathPrev = id;
+            }
+        }
+        if (node.pathUS >= m_nodes[last].pathUS)
+        {
+            last = id;
+        }
+    }
+    stats.criticalPathUS = m_nodes[last].pathUS;
+    for (NodeId id = last; id != kNoNode; id = m_nodes[id].pathPrev)
+    {
+        stats.criticalPath.push_back(id);
+    }
+    std::reverse(stats.criticalPath.begin(), stats.criticalPath.end());
+}
+
+std::string TaskGraph::criticalPathString() const
+{
+    std::string out;
+    for (NodeId id : m_lastRun.criticalPath)
+    {
+        const Node &node = m_nodes[id];
+        if (!out.empty())
+        {
+            out += " -> ";
+        }
+        out += node.name + "(" + std::to_string(node.endUS - node.beginUS) + "us)";
+    }
+    return out;
+}
@@ -0,0 +1,171 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+/**
+ * @brief 有向无环任务图
+ * @details 节点是可调用对象，边是依赖关系，交给Scheduler执行。
+ * 每个节点有一个原子的前驱计数，前驱全部完成(计数减到0)的节点马上可以执行：
+ * 完成节点的工作线程接着直接执行第一个就绪的后继，省掉一次入队出队，其余就绪的后继放入任务队列。
+ * 图在第一次执行时做拓扑排序并分配好所有状态，之后重复执行不再分配内存(除非修改了图)。
+ * 每次执行记录各节点的开始结束时间，算出关键路径(按实际耗时最长的依赖链)
+ */
+#include "Scheduler.h"
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+class TaskGraph : Noncopyable
+{
+public:
+    typedef size_t NodeId;
+
+    /**
+     * @brief 一次执行的统计
+     */
+    struct RunStats
+    {
+        /// 从run()开始到最后一个节点结束的时间(微秒)
+        uint64_t wallUS = 0;
+        /// 所有节点耗时之和(微秒)
+        uint64_t workUS = 0;
+        /// 关键路径上的节点耗时之和(微秒)，wallUS不可能小于它
+        uint64_t criticalPathUS = 0;
+        /// 关键路径，按执行顺序
+        std::vector<NodeId> criticalPath;
+        /// 在前驱的工作线程上直接执行、没有经过任务队列的节点数
+        size_t inlineCount = 0;
+    };
+
+    /**
+     * @brief 构造函数
+     * @param[in] name 名称，用于日志
+     */
+    explicit TaskGraph(const std::string &name = "TaskGraph");
+
+    /**
+     * @brief 添加节点
+     * @param[in] func 节点执行的函数
+     * @param[in] name 节点名称，用于关键路径的输出
+     * @return 节点id，从0开始连续编号
+     */
+    NodeId addNode(std::function<void()> func, const std::string &name = "");
+
+    /**
+     * @brief 添加依赖：after在before完成之后才能执行
+     */
+    void addEdge(NodeId before, NodeId after);
+
+    /**
+     * @brief 节点数
+     */
+    size_t getNodeCount() const { return m_nodes.size(); }
+
+    /**
+     * @brief 节点名称
+     */
+    const std::string &getNodeName(NodeId id) const { return m_nodes[id].name; }
+
+    /**
+     * @brief 在调度器上执行一次，所有节点完成后返回
+     * @details 在调度器的有栈协程中调用时挂起当前协程等待，工作线程继续执行节点；
+     * 在其他线程中调用时阻塞等待。
+     * 节点抛出的第一个异常在返回前重新抛出，此后还没开始的节点不再执行。
+     * 图中有环时抛出std::logic_error。同一个图不能同时执行多次
+     * @param[in] scheduler 调度器，必须已经启动
+     */
+    void run(SchedulerBase &scheduler);
+
+    /**
+     * @brief 最近一次执行的统计
+     */
+    const RunStats &getLastRun() const { return m_lastRun; }
+
+    /**
+     * @brief 执行次数
+     */
+    uint64_t getRunCount() const { return m_runCount; }
+
+    /**
+     * @brief 最近一次执行的关键路径，格式为"name(us) -> name(us)"
+     */
+    std::string criticalPathString() const;
+
+private:
+    struct Node
+    {
+        std::function<void()> func;
+        std::string name;
+        std::vector<NodeId> successors;
+        // 前驱数
+        size_t predecessors = 0;
+        // 本次执行还没完成的前驱数
+        std::atomic<size_t> pending = {0};
+        // 本次执行的开始和结束时间(微秒)
+        uint64_t beginUS = 0;
+        uint64_t endUS = 0;
+        // 计算关键路径用：以该节点结尾的最长依赖链耗时，以及链上的前一个节点
+        uint64_t pathUS = 0;
+        NodeId pathPrev = 0;
+    };
+
+    /// 没有节点
+    static const NodeId kNoNode = (NodeId)-1;
+
+    /**
+     * @brief 拓扑排序，找出入口节点，检查有没有环
+     */
+    void prepare();
+
+    /**
+     * @brief 执行一个就绪的节点，之后继续执行它就绪的第一个后继
+     */
+    void execute(NodeId id);
+
+    /**
+     * @brief 一个节点完成，最后一个节点完成时唤醒run()
+     */
+    void finishNode();
+
+    /**
+     * @brief 根据各节点的时间计算本次执行的统计
+     */
+    void collectStats(uint64_t begin_us);
+
+private:
+    std::string m_name;
+    // deque扩容不移动已有元素，Node中有原子变量不能移动
+    std::deque<Node> m_nodes;
+    // 拓扑序和入口节点，prepare()之后有效
+    std::vector<NodeId> m_order;
+    std::vector<NodeId> m_roots;
+    // 图修改过，下次执行前要重新prepare()
+    bool m_dirty = true;
+    // 正在执行的调度器
+    SchedulerBase *m_scheduler = nullptr;
+    // 本次执行还没完成的节点数
+    std::atomic<size_t> m_remaining = {0};
+    // 是否有节点抛出了异常，之后的节点不再执行
+    std::atomic<bool> m_failed = {false};
+    // 保护m_error
+    Spinlock m_errorLock;
+    std::exception_ptr m_error;
+    // 直接执行的后继数
+    std::atomic<size_t> m_inlineCount = {0};
+    // run()的等待方式：挂起协程时为等待中的协程，否则在m_joinState上futex等待。
+    // 最后一个完成的节点对图的最后一次访问是把状态换成JOIN_DONE，run()看到JOIN_DONE才返回
+    enum JoinState
+    {
+        JOIN_RUNNING,
+        JOIN_DONE,
+        JOIN_PARKED
+    };
+    std::atomic<int> m_joinState = {JOIN_RUNNING};
+    Coroutine::ptr m_waiter;
+    bool m_waitOnFutex = false;
+    uint64_t m_runCount = 0;
+    RunStats m_lastRun;
+};
+
+#endif
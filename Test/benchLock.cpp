@@ -0,0 +1,105 @@
+/**
+ * @file benchLock.cpp
+ * @brief 各种锁在不同线程数下的吞吐和公平性对比
+ * @details 用法：./benchLock [最大线程数] [每轮测试的毫秒数]
+ * 每个线程在限定时间内反复加锁，统计总吞吐(每次加锁解锁的平均耗时)
+ * 和公平性(加锁次数最少的线程/最多的线程，越接近1越公平)
+ */
+#include "../Thread/Threads.h"
+#include "../util.h"
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+
+static uint64_t s_shared = 0;
+
+struct BenchResult
+{
+    // 每次加锁解锁的平均耗时(纳秒)
+    double nsPerOp;
+    // 加锁次数最少的线程/最多的线程
+    double fairness;
+};
+
+template <class LockType>
+BenchResult bench(LockType &mutex, int threads, uint64_t duration_ms)
+{
+    std::atomic<bool> stop{false};
+    std::vector<uint64_t> counts(threads * 8, 0);
+    s_shared = 0;
+    std::vector<Thread::ptr> thrs;
+    uint64_t begin = ybb::GetCurrentUS();
+    for (int i = 0; i < threads; i++)
+    {
+        // 每个线程的计数相隔一个缓存行
+        uint64_t *count = &counts[i * 8];
+        thrs.push_back(Thread::ptr(new Thread([&mutex, &stop, count]() {
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                typename LockType::Lock lock(mutex);
+                ++s_shared;
+                ++*count;
+            }
+        }, "bench_" + std::to_string(i))));
+    }
+    usleep(duration_ms * 1000);
+    stop = true;
+    for (auto &i : thrs)
+    {
+        i->join();
+    }
+    uint64_t cost = ybb::GetCurrentUS() - begin;
+
+    uint64_t total = 0, min_count = UINT64_MAX, max_count = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        total += counts[i * 8];
+        min_count = std::min(min_count, counts[i * 8]);
+        max_count = std::max(max_count, counts[i * 8]);
+    }
+    if (s_shared != total)
+    {
+        printf("lost update: %lu != %lu\n", s_shared, total);
+        exit(1);
+    }
+    return BenchResult{cost * 1000.0 / std::max<uint64_t>(total, 1), max_count ? (double)min_count / max_count : 0};
+}
+
+template <class LockType>
+void run(const char *name, int max_threads, uint64_t duration_ms)
+{
+    printf("%-12s", name);
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        LockType mutex;
+        BenchResult result = bench(mutex, threads, duration_ms);
+        printf(" %8.1fns/%.2f", result.nsPerOp, result.fairness);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    uint64_t duration_ms = argc > 2 ? atoll(argv[2]) : 50;
+
+    printf("%-12s", "lock");
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        printf(" %11d thr", threads);
+    }
+    printf("\n");
+
+    run<Mutex>("Mutex", max_threads, duration_ms);
+    run<Spinlock>("Spinlock", max_threads, duration_ms);
+    run<CASLock>("CASLock", max_threads, duration_ms);
+    run<FutexMutex>("FutexMutex", max_threads, duration_ms);
+    run<TicketLock>("TicketLock", max_threads, duration_ms);
+    run<MCSLock>("MCSLock", max_threads, duration_ms);
+
+    StatsFutexMutex futex;
+    bench(futex, max_threads, duration_ms);
+    printf("FutexMutex with %d threads: contended=%lu spin=%lu wait=%lu\n",
+           max_threads, futex.getContended(), futex.getSpinAcquired(), futex.getFutexWaits());
+    return 0;
+}
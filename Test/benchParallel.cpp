@@ -0,0 +1,77 @@
+/**
+ * @file benchParallel.cpp
+ * @brief fork-join并行算法在1..N个工作线程上的扩展性
+ * @details 用法：./benchParallel [最大线程数] [元素数]
+ * 每个线程数新建一个调度器，由主线程发起调用(主线程也参与执行)，
+ * 与串行版本对比：parallel_for(每个元素做一段浮点计算)、parallel_reduce(求和)、parallel_sort
+ */
+#include "../Scheduler/Parallel.h"
+#include <math.h>
+#include <stdlib.h>
+#include <thread>
+
+static const size_t kGrain = 1024;
+
+static double Work(size_t i)
+{
+    double x = i;
+    for (int k = 0; k < 32; k++)
+    {
+        x = sqrt(x + k);
+    }
+    return x;
+}
+
+struct Timings
+{
+    double forMS;
+    double reduceMS;
+    double sortMS;
+};
+
+static Timings Run(Scheduler *sc, const std::vector<int> &data)
+{
+    size_t n = data.size();
+    std::vector<double> out(n);
+    Timings t;
+    uint64_t begin = ybb::GetCurrentUS();
+    parallel_for(0, n, kGrain, [&](size_t i) { out[i] = Work(i); }, sc);
+    t.forMS = (ybb::GetCurrentUS() - begin) / 1000.0;
+
+    begin = ybb::GetCurrentUS();
+    volatile double sum = parallel_reduce(
+        0, n, kGrain, 0.0, [&](size_t i) { return out[i]; }, [](double a, double b) { return a + b; }, sc);
+    (void)sum;
+    t.reduceMS = (ybb::GetCurrentUS() - begin) / 1000.0;
+
+    std::vector<int> copy = data;
+    begin = ybb::GetCurrentUS();
+    parallel_sort(copy.begin(), copy.end(), std::less<>(), 0, sc);
+    t.sortMS = (ybb::GetCurrentUS() - begin) / 1000.0;
+    return t;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_threads = argc > 1 ? atoi(argv[1]) : std::max(4u, std::thread::hardware_concurrency());
+    size_t n = argc > 2 ? atoll(argv[2]) : 1000000;
+    std::vector<int> data(n);
+    for (auto &i : data)
+    {
+        i = rand();
+    }
+    Timings serial = Run(nullptr, data);
+    printf("%zu elements, %u hardware threads, ms (speedup)\n", n, std::thread::hardware_concurrency());
+    printf("%-8s %18s %18s %18s\n", "threads", "parallel_for", "parallel_reduce", "parallel_sort");
+    printf("%-8s %11.1f        %11.1f        %11.1f\n", "serial", serial.forMS, serial.reduceMS, serial.sortMS);
+    for (size_t threads = 1; threads <= max_threads; threads++)
+    {
+        Scheduler sc(threads, false, "bench");
+        sc.start();
+        Timings t = Run(&sc, data);
+        sc.stop();
+        printf("%-8zu %11.1f (%4.2f) %11.1f (%4.2f) %11.1f (%4.2f)\n", threads, t.forMS, serial.forMS / t.forMS,
+               t.reduceMS, serial.reduceMS / t.reduceMS, t.sortMS, serial.sortMS / t.sortMS);
+    }
+    return 0;
+}
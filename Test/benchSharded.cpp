@@ -0,0 +1,133 @@
+/**
+ * @file benchSharded.cpp
+ * @brief 共享任务队列的Scheduler与分片调度器ShardedScheduler的吞吐对比
+ * @details 用法：./benchSharded [线程数] [每个线程的任务数]
+ * local：每个线程上一条任务链，每个任务执行完把下一个任务投递给自己所在的线程/分片；
+ * hop：同样的任务链，但每个任务投递给下一个线程/分片(Scheduler指定线程号)。
+ * Scheduler的每次投递都要抢全局任务队列的锁，分片调度器分片内没有锁，跨分片只走SPSC环
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../Scheduler/ShardedScheduler.h"
+#include <stdlib.h>
+
+static std::atomic<uint64_t> s_done;
+
+struct SchedulerChain
+{
+    Scheduler *sc;
+    std::vector<int> *tids;
+    size_t thread;
+    bool hop;
+
+    void operator()(uint64_t left) const
+    {
+        if (!left)
+        {
+            ++s_done;
+            return;
+        }
+        SchedulerChain next = *this;
+        if (hop)
+        {
+            next.thread = (thread + 1) % tids->size();
+        }
+        sc->schedule(std::function<void()>([next, left]() { next(left - 1); }), (*tids)[next.thread]);
+    }
+};
+
+static double BenchScheduler(size_t threads, uint64_t tasks, bool hop)
+{
+    Scheduler sc(threads, false, "bench");
+    sc.start();
+    // 工作线程的线程号，schedule指定线程时使用
+    std::vector<int> tids(threads);
+    std::atomic<size_t> ready{0};
+    for (size_t i = 0; i < threads; i++)
+    {
+        sc.schedule([&tids, &ready]() {
+            static std::atomic<size_t> seq{0};
+            tids[seq++ % tids.size()] = ybb::GetThreadId();
+            ++ready;
+            // 占住线程直到所有线程都登记完，保证每个线程各拿到一个登记任务
+            while (ready < tids.size())
+            {
+                sched_yield();
+            }
+        });
+    }
+    while (ready < threads)
+    {
+        usleep(100);
+    }
+    s_done = 0;
+    uint64_t begin = ybb::GetCurrentUS();
+    for (size_t i = 0; i < threads; i++)
+    {
+        SchedulerChain chain{&sc, &tids, i, hop};
+        chain(tasks);
+    }
+    while (s_done < threads)
+    {
+        usleep(100);
+    }
+    uint64_t cost = ybb::GetCurrentUS() - begin;
+    sc.stop();
+    return cost * 1000.0 / (threads * tasks);
+}
+
+struct ShardChain
+{
+    ShardedScheduler *sc;
+    bool hop;
+
+    void operator()(uint64_t left) const
+    {
+        if (!left)
+        {
+            ++s_done;
+            return;
+        }
+        size_t shard = ShardedScheduler::GetShardId();
+        if (hop)
+        {
+            shard = (shard + 1) % sc->getShardCount();
+        }
+        ShardChain next = *this;
+        sc->post(shard, [next, left]() { next(left - 1); });
+    }
+};
+
+static double BenchSharded(size_t threads, uint64_t tasks, bool hop)
+{
+    ShardedScheduler sc(threads, "bench");
+    sc.start();
+    s_done = 0;
+    uint64_t begin = ybb::GetCurrentUS();
+    for (size_t i = 0; i < threads; i++)
+    {
+        ShardChain chain{&sc, hop};
+        sc.post(i, [chain, tasks]() { chain(tasks); });
+    }
+    while (s_done < threads)
+    {
+        usleep(100);
+    }
+    uint64_t cost = ybb::GetCurrentUS() - begin;
+    sc.stop();
+    return cost * 1000.0 / (threads * tasks);
+}
+
+int main(int argc, char **argv)
+{
+    size_t threads = argc > 1 ? atoi(argv[1]) : 2;
+    uint64_t tasks = argc > 2 ? atoll(argv[2]) : 20000;
+    printf("%zu threads, %lu tasks per thread, ns per task\n", threads, tasks);
+    printf("%-8s %12s %16s\n", "pattern", "Scheduler", "ShardedScheduler");
+    for (bool hop : {false, true})
+    {
+        double shared = BenchScheduler(threads, tasks, hop);
+        double sharded = BenchSharded(threads, tasks, hop);
+        printf("%-8s %12.1f %16.1f\n", hop ? "hop" : "local", shared, sharded);
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file benchStartup.cpp
+ * @brief 线程和调度器启动耗时
+ * @details 用法：./benchStartup [线程数]
+ */
+#include "../Scheduler/Scheduler.h"
+#include <stdlib.h>
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 64;
+
+    // 逐个创建，每个线程跑起来之后才创建下一个
+    std::vector<Thread::ptr> thrs;
+    uint64_t begin = ybb::GetCurrentUS();
+    for (int i = 0; i < threads; i++)
+    {
+        thrs.push_back(Thread::ptr(new Thread([]() {}, "serial_" + std::to_string(i))));
+    }
+    uint64_t serial = ybb::GetCurrentUS() - begin;
+    for (auto &i : thrs)
+    {
+        i->join();
+    }
+    thrs.clear();
+
+    // 批量创建，全部创建完再一起等待
+    ThreadAttr attr;
+    attr.stackSize = 256 * 1024;
+    begin = ybb::GetCurrentUS();
+    for (int i = 0; i < threads; i++)
+    {
+        thrs.push_back(Thread::ptr(new Thread([]() {}, "batch_" + std::to_string(i), attr, false)));
+    }
+    for (auto &i : thrs)
+    {
+        i->waitStarted();
+    }
+    uint64_t batch = ybb::GetCurrentUS() - begin;
+    for (auto &i : thrs)
+    {
+        i->join();
+    }
+
+    Scheduler sc(threads, false, "startup");
+    sc.setThreadAttr(attr);
+    sc.start();
+    uint64_t scheduler = sc.getStartupUS();
+    sc.stop();
+
+    printf("%d threads: serial %lu us, batch %lu us, Scheduler::start %lu us\n", threads, serial, batch, scheduler);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file testArena.cpp
+ * @brief 协程内存池测试
+ */
+#include "../Scheduler/Scheduler.h"
+#include <assert.h>
+#include <vector>
+#include <map>
+
+static Coroutine *s_handler = nullptr;
+
+void handler()
+{
+    s_handler = Coroutine::GetCurrent();
+    std::vector<int, ArenaAllocator<int>> vec;
+    std::map<int, int, std::less<int>, ArenaAllocator<std::pair<const int, int>>> m;
+    for (int i = 0; i < 10000; i++)
+    {
+        vec.push_back(i);
+        m[i] = i * 2;
+    }
+    assert(m[9999] == 19998);
+    void *big = Coroutine::GetArena()->allocate(100 * 1024, 64);
+    assert(((uintptr_t)big & 63) == 0);
+    printf("arena chunks: %lu\n", s_handler->getArena().chunkCount());
+    assert(s_handler->getArena().chunkCount() > 1);
+}
+
+int main()
+{
+    printf("main begin\n");
+    Scheduler sc;
+    Coroutine::ptr co(new Coroutine(handler));
+    sc.schedule(co);
+    sc.start();
+    sc.stop();
+
+    // 协程结束时内存池已经整体释放
+    assert(co->getState() == Coroutine::TERM);
+    assert(co->getArena().chunkCount() == 0);
+
+    Arena arena;
+    arena.allocate(100);
+    arena.allocate(Arena::kChunkSize);
+    assert(arena.chunkCount() == 2);
+    arena.rewind();
+    assert(arena.chunkCount() == 1);
+    printf("main end\n");
+    return 0;
+}
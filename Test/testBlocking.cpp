@@ -0,0 +1,83 @@
+/**
+ * @file testBlocking.cpp
+ * @brief 阻塞调用交给BlockingPool执行：调用期间工作线程继续执行别的任务，
+ * 完成后协程带着结果回到原来的调度器，异常在协程中重新抛出
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../Scheduler/BlockingPool.h"
+#include <assert.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <unistd.h>
+
+static const uint64_t kBlockMS = 200;
+
+int main()
+{
+    // 不在协程里直接执行
+    assert(Scheduler::blocking([]() { return 1; }) == 1);
+    {
+        Scheduler sc(1, false, "blocking");
+        sc.start();
+        static std::atomic<uint64_t> begin, short_done, blocking_done;
+        static std::atomic<int> result;
+        static std::atomic<bool> caught, same_thread;
+        begin = ybb::GetCurrentMS();
+        short_done = blocking_done = 0;
+        sc.schedule([]() {
+            result = Scheduler::blocking([]() {
+                usleep(kBlockMS * 1000);
+                return 42;
+            });
+            blocking_done = ybb::GetCurrentMS();
+
+            try
+            {
+                Scheduler::blocking([]() { throw std::runtime_error("blocking failed"); });
+            }
+            catch (const std::runtime_error &e)
+            {
+                caught = true;
+            }
+
+            int tid = ybb::GetThreadId();
+            Scheduler::blocking([]() { usleep(1000); }, true);
+            same_thread = tid == ybb::GetThreadId();
+        });
+        // 唯一的工作线程没有被阻塞调用占住
+        sc.schedule([]() { short_done = ybb::GetCurrentMS(); });
+        sc.stop();
+        printf("short task done after %lums, blocking call returned after %lums\n", short_done - begin,
+               blocking_done - begin);
+        assert(result == 42);
+        assert(short_done && short_done < blocking_done);
+        assert(blocking_done - begin >= kBlockMS);
+        assert(caught && same_thread);
+        assert(sc.getBlockingCount() == 0);
+    }
+    {
+        // 线程按需创建，不超过上限，空闲超时后退出
+        BlockingPool pool(2, 50, "pool");
+        static std::atomic<int> done;
+        done = 0;
+        for (int i = 0; i < 6; i++)
+        {
+            pool.submit([]() {
+                usleep(10000);
+                ++done;
+            });
+        }
+        assert(pool.getThreadCount() <= 2);
+        while (done < 6)
+        {
+            usleep(1000);
+        }
+        usleep(200 * 1000);
+        printf("pool spawned %lu threads, %lu jobs, %zu alive\n", pool.getSpawnedCount(), pool.getJobCount(),
+               pool.getThreadCount());
+        assert(pool.getSpawnedCount() == 2 && pool.getJobCount() == 6);
+        assert(pool.getThreadCount() == 0);
+    }
+    printf("testBlocking passed\n");
+    return 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file testCoroutineLocal.cpp
+ * @brief 协程局部变量测试
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../Coroutine/CoroutineLocal.h"
+#include <assert.h>
+#include <string>
+
+struct RequestContext
+{
+    std::string traceId;
+    ~RequestContext() { ++s_destroyed; }
+    static int s_destroyed;
+};
+int RequestContext::s_destroyed = 0;
+
+static CoroutineLocal<RequestContext> s_context;
+static CoroutineLocal<int> s_counters[12];
+
+void handler(int i)
+{
+    s_context->traceId = "trace-" + std::to_string(i);
+    // 超过内联槽数量的下标走溢出数组
+    for (int k = 0; k < 12; k++)
+    {
+        s_counters[k].set(new int(i * 100 + k));
+    }
+
+    // 让出后其他协程会设置自己的值，互不影响
+    Scheduler::GetThis()->schedule(Coroutine::GetThis());
+    Coroutine::GetThis()->yield();
+
+    assert(s_context->traceId == "trace-" + std::to_string(i));
+    for (int k = 0; k < 12; k++)
+    {
+        assert(*s_counters[k].get() == i * 100 + k);
+    }
+    printf("handler %d: %s\n", i, s_context->traceId.c_str());
+}
+
+int main()
+{
+    printf("main begin\n");
+    Scheduler sc;
+    for (int i = 0; i < 5; i++)
+    {
+        sc.schedule(Coroutine::ptr(new Coroutine(std::bind(handler, i))));
+    }
+    sc.start();
+    sc.stop();
+
+    // 每个协程结束时都析构了自己的上下文
+    printf("destroyed %d contexts\n", RequestContext::s_destroyed);
+    assert(RequestContext::s_destroyed == 5);
+    assert(s_context.get() == nullptr);
+    printf("main end\n");
+    return 0;
+}
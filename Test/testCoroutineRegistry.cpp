@@ -0,0 +1,98 @@
+/**
+ * @file testCoroutineRegistry.cpp
+ * @brief 协程注册表：列出存活协程、等待原因、栈水位和挂起位置的调用栈
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../Coroutine/CoroutineRegistry.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+static const int kParked = 3;
+
+/**
+ * @brief 睡眠一段时间，挂起的协程调用栈里应该能看到这个函数
+ */
+__attribute__((noinline)) void ParkHere(uint64_t ms)
+{
+    char buf[4096];
+    memset(buf, 1, sizeof(buf));
+    Scheduler::GetThis()->scheduleAfter(Coroutine::GetThis(), ms);
+    Coroutine::GetCurrent()->yield();
+    asm volatile("" : : "r"(buf) : "memory");
+}
+
+static std::string ReadFile(const char *path)
+{
+    std::string content;
+    FILE *fp = fopen(path, "r");
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+        content.append(buf, n);
+    }
+    fclose(fp);
+    return content;
+}
+
+int main()
+{
+    size_t base = CoroutineRegistry::Count();
+
+    Scheduler sc(1, false, "registry");
+    sc.start();
+    for (int i = 0; i < kParked; i++)
+    {
+        sc.schedule(Coroutine::ptr(new Coroutine([]() { ParkHere(300); })));
+    }
+    usleep(100 * 1000);
+
+    int parked = 0;
+    for (auto &info : CoroutineRegistry::Snapshot())
+    {
+        if (info.waitReason && strcmp(info.waitReason, "sleep") == 0)
+        {
+            parked++;
+            assert(info.state == Coroutine::READY);
+            assert(info.scheduler == &sc);
+            // ParkHere的栈上数组已经写过，最高水位至少有4K
+            assert(info.stackUsed >= 4096 && info.stackUsed <= info.stackSize);
+            assert(info.backtrace.size() >= 2);
+        }
+    }
+    printf("parked=%d\n", parked);
+    assert(parked == kParked);
+
+    // 导出结果中能看到函数名(链接时需要-rdynamic)
+    char path[] = "/tmp/testRegistryXXXXXX";
+    int fd = mkstemp(path);
+    CoroutineRegistry::Dump(fd);
+    std::string dump = ReadFile(path);
+    assert(dump.find("ParkHere") != std::string::npos);
+    assert(dump.find("wait=sleep") != std::string::npos);
+
+    // 信号触发导出
+    ftruncate(fd, 0);
+    lseek(fd, 0, SEEK_SET);
+    CoroutineRegistry::InstallSignalHandler(SIGUSR1, fd);
+    raise(SIGUSR1);
+    for (int i = 0; i < 100 && ReadFile(path).find("coroutines") == std::string::npos; i++)
+    {
+        usleep(10 * 1000);
+    }
+    dump = ReadFile(path);
+    assert(dump.find("coroutines") != std::string::npos);
+    printf("%s", dump.c_str());
+    close(fd);
+    unlink(path);
+
+    sc.stop();
+    // 工作线程已经退出，剩下的只有主线程的协程
+    printf("live=%zu base=%zu\n", CoroutineRegistry::Count(), base);
+    assert(CoroutineRegistry::Count() <= base + 1);
+    printf("testCoroutineRegistry ok\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file testElastic.cpp
+ * @brief 弹性工作线程：任务积压时逐个增加工作线程直到上限，空闲一段时间后退回下限；
+ * 扩容进行中调用stop()不会漏掉任务也不会卡住
+ */
+#include "../Scheduler/Scheduler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static const int kTasks = 40;
+static const uint64_t kTaskMS = 10;
+
+static std::atomic<int> s_done;
+static std::atomic<int> s_running, s_maxRunning;
+
+static void Work()
+{
+    int n = ++s_running;
+    int m = s_maxRunning;
+    while (n > m && !s_maxRunning.compare_exchange_weak(m, n))
+    {
+    }
+    usleep(kTaskMS * 1000);
+    --s_running;
+    ++s_done;
+}
+
+int main()
+{
+    ElasticConfig config;
+    config.maxThreads = 4;
+    config.queueDepth = 0;
+    config.queueLatencyUS = 5000;
+    config.idleMS = 100;
+    config.checkUS = 2000;
+    {
+        Scheduler sc(1, false, "elastic");
+        sc.setElastic(config);
+        sc.start();
+        s_done = s_maxRunning = 0;
+        uint64_t begin = ybb::GetCurrentMS();
+        for (int i = 0; i < kTasks; i++)
+        {
+            sc.schedule(&Work);
+        }
+        while (s_done < kTasks)
+        {
+            usleep(1000);
+        }
+        uint64_t cost = ybb::GetCurrentMS() - begin;
+        printf("%d tasks in %lums, max concurrency %d, scaled up %lu times\n", kTasks, cost, s_maxRunning.load(),
+               sc.getScaleUpCount());
+        assert(sc.getScaleUpCount() >= 1 && sc.getScaleUpCount() <= 3);
+        assert(s_maxRunning > 1 && s_maxRunning <= 4);
+        assert(cost < kTasks * kTaskMS);
+
+        // 空闲后退回下限
+        uint64_t wait_begin = ybb::GetCurrentMS();
+        while (sc.getThreadCount() > 1 && ybb::GetCurrentMS() - wait_begin < 2000)
+        {
+            usleep(1000);
+        }
+        assert(sc.getThreadCount() == 1);
+        assert(sc.getScaleDownCount() == sc.getScaleUpCount());
+
+        std::vector<ScaleEvent> events = sc.getScaleEvents();
+        assert(events.size() == sc.getScaleUpCount() * 2);
+        for (auto &e : events)
+        {
+            printf("%s threads=%zu depth=%zu time_to_scale=%luus\n", e.up ? "up  " : "down", e.threads,
+                   e.queueDepth, e.timeToScaleUS);
+            if (e.up)
+            {
+                assert(e.timeToScaleUS >= config.queueLatencyUS);
+            }
+            else
+            {
+                assert(e.timeToScaleUS >= config.idleMS * 1000);
+            }
+        }
+        sc.stop();
+    }
+    {
+        // 积压的同时停止，所有任务都执行完，扩出来的线程全部退出
+        Scheduler sc(1, false, "elastic_stop");
+        sc.setElastic(config);
+        sc.start();
+        s_done = 0;
+        for (int i = 0; i < kTasks; i++)
+        {
+            sc.schedule(&Work);
+        }
+        usleep(10 * 1000);
+        sc.stop();
+        printf("stopped with %d tasks done, scaled up %lu times\n", s_done.load(), sc.getScaleUpCount());
+        assert(s_done == kTasks);
+        assert(sc.getThreadCount() == 1);
+    }
+    printf("testElastic passed\n");
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file testLockProfiler.cpp
+ * @brief 锁竞争分析测试
+ */
+#ifndef LOCK_PROFILING
+#define LOCK_PROFILING
+#endif
+#include "../Mutex/LockProfiler.h"
+#include "../Thread/Threads.h"
+#include <assert.h>
+#include <unistd.h>
+
+static Mutex s_hot;
+static Mutex s_cold;
+static RWMutex s_rw;
+static int s_value = 0;
+
+void worker()
+{
+    for (int i = 0; i < 2000; i++)
+    {
+        {
+            SCOPED_LOCK_NAMED(Mutex, lock, s_hot, "hot");
+            ++s_value;
+            usleep(1);
+        }
+        if (i % 100 == 0)
+        {
+            SCOPED_LOCK_NAMED(Mutex, lock, s_cold, "cold");
+            ++s_value;
+        }
+        READ_SCOPED_LOCK(RWMutex, lock, s_rw);
+    }
+}
+
+int main()
+{
+    std::vector<Thread::ptr> thrs;
+    for (int i = 0; i < 4; i++)
+    {
+        thrs.push_back(Thread::ptr(new Thread(&worker, "worker_" + std::to_string(i))));
+    }
+    for (auto &i : thrs)
+    {
+        i->join();
+    }
+
+    printf("%s", LockProfiler::Report().c_str());
+    std::vector<LockStat> stats = LockProfiler::Collect();
+    assert(stats.size() == 3);
+    assert(stats[0].name == "hot");
+    assert(stats[0].acquires == 8000);
+    LockProfiler::Reset();
+    assert(LockProfiler::Collect().empty());
+    return 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file testLog.cpp
+ * @brief 异步日志：多线程写日志，检查条数并测量调用线程的开销
+ */
+#include "../Log/Log.h"
+#include "../Scheduler/Scheduler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int kThreads = 4;
+static const int kPerThread = 500;
+
+int main()
+{
+    char path[] = "/tmp/testLogXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    Logger::SetFd(fd);
+
+    // 低于编译期级别的日志参数不会求值
+    int evaluated = 0;
+    YBB_LOG_DEBUG("never %d", ++evaluated);
+    assert(evaluated == 0 || YBB_LOG_LEVEL == 0);
+
+    std::vector<Thread::ptr> thrs;
+    uint64_t begin = ybb::GetCurrentUS();
+    for (int i = 0; i < kThreads; i++)
+    {
+        thrs.push_back(Thread::ptr(new Thread([]() {
+            for (int j = 0; j < kPerThread; j++)
+            {
+                YBB_LOG_INFO("message %d", j);
+                // 给后台线程留出时间，避免队列写满丢日志
+                if (j % 256 == 255)
+                {
+                    Logger::Flush();
+                }
+            }
+        }, "log_" + std::to_string(i))));
+    }
+    for (auto &t : thrs)
+    {
+        t->join();
+    }
+    uint64_t cost = ybb::GetCurrentUS() - begin;
+    Logger::Flush();
+
+    FILE *fp = fopen(path, "r");
+    char line[512];
+    int lines = 0;
+    bool named = false;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (!strstr(line, "message"))
+        {
+            continue;
+        }
+        lines++;
+        if (strstr(line, " INFO ") && strstr(line, "log_0") && strstr(line, "testLog.cpp"))
+        {
+            named = true;
+        }
+    }
+    fclose(fp);
+    unlink(path);
+    Logger::SetFd(STDOUT_FILENO);
+
+    printf("lines=%d dropped=%lu %.1fus per record\n", lines, Logger::Dropped(),
+           (double)cost / (kThreads * kPerThread));
+    assert(lines + (int)Logger::Dropped() == kThreads * kPerThread);
+    assert(named);
+    printf("testLog ok\n");
+    return 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file testParallel.cpp
+ * @brief fork-join并行算法：每个下标恰好执行一次、归约按顺序合并、排序和变换的结果、
+ * 异常传回发起者、在调度器协程中嵌套调用，以及没有调度器时串行执行
+ */
+#include "../Scheduler/Parallel.h"
+#include <assert.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+static const size_t kCount = 100000;
+
+static void TestAlgorithms(Scheduler *sc)
+{
+    // 每个下标恰好执行一次
+    std::vector<std::atomic<int>> hits(kCount);
+    parallel_for(0, kCount, 64, [&](size_t i) { ++hits[i]; }, sc);
+    for (auto &i : hits)
+    {
+        assert(i == 1);
+    }
+
+    uint64_t sum = parallel_reduce(
+        0, kCount, 100, (uint64_t)0, [](size_t i) { return (uint64_t)i; },
+        [](uint64_t a, uint64_t b) { return a + b; }, sc);
+    assert(sum == (uint64_t)kCount * (kCount - 1) / 2);
+
+    // 字符串拼接不满足交换律，结果仍然按下标顺序
+    std::string digits = parallel_reduce(
+        0, 1000, 7, std::string(), [](size_t i) { return std::to_string(i % 10); },
+        [](std::string a, const std::string &b) { return a + b; }, sc);
+    assert(digits.size() == 1000);
+    for (size_t i = 0; i < digits.size(); i++)
+    {
+        assert(digits[i] == '0' + (char)(i % 10));
+    }
+
+    std::vector<int> in(kCount), out(kCount);
+    for (size_t i = 0; i < kCount; i++)
+    {
+        in[i] = rand();
+    }
+    parallel_transform(in.begin(), in.end(), out.begin(), [](int v) { return v / 2; }, 0, sc);
+    for (size_t i = 0; i < kCount; i++)
+    {
+        assert(out[i] == in[i] / 2);
+    }
+
+    std::vector<int> expect = in;
+    std::sort(expect.begin(), expect.end());
+    parallel_sort(in.begin(), in.end(), std::less<>(), 1000, sc);
+    assert(in == expect);
+    parallel_sort(out.begin(), out.end(), std::greater<>(), 0, sc);
+    assert(std::is_sorted(out.begin(), out.end(), std::greater<>()));
+
+    // 第一个异常传回发起者，并行时其他区间照常执行
+    std::atomic<size_t> done{0};
+    bool caught = false;
+    try
+    {
+        parallel_for(0, 1000, 10,
+                     [&](size_t i) {
+                         if (i == 500)
+                         {
+                             throw std::runtime_error("bad index");
+                         }
+                         ++done;
+                     },
+                     sc);
+    }
+    catch (const std::runtime_error &)
+    {
+        caught = true;
+    }
+    assert(caught);
+    // 只有抛出异常的区间(不超过粒度)没有执行完
+    assert(!sc || done >= 990);
+}
+
+int main()
+{
+    // 没有调度器时串行执行
+    assert(Scheduler::GetThis() == nullptr);
+    TestAlgorithms(nullptr);
+    {
+        // 外部线程发起，工作线程帮忙
+        Scheduler sc(3, false, "parallel");
+        sc.start();
+        TestAlgorithms(&sc);
+        sc.stop();
+    }
+    {
+        // 在调度器的协程中发起，并且区间里再嵌套并行调用
+        Scheduler sc(2, false, "nested");
+        sc.start();
+        static std::atomic<bool> finished;
+        static std::atomic<uint64_t> nested;
+        finished = false;
+        nested = 0;
+        sc.schedule([]() {
+            TestAlgorithms(Scheduler::GetThis());
+            parallel_for(0, 16, 1, [](size_t) {
+                nested += parallel_reduce(
+                    0, 1000, 50, (uint64_t)0, [](size_t i) { return (uint64_t)i; },
+                    [](uint64_t a, uint64_t b) { return a + b; });
+            });
+            finished = true;
+        });
+        sc.stop();
+        assert(finished);
+        assert(nested == 16 * 499500ul);
+    }
+    {
+        // use_caller的单线程调度器，所有区间都在同一个线程上执行
+        Scheduler sc(1, true, "single");
+        static std::atomic<bool> finished;
+        finished = false;
+        sc.schedule([]() {
+            TestAlgorithms(Scheduler::GetThis());
+            finished = true;
+        });
+        sc.start();
+        sc.stop();
+        assert(finished);
+    }
+    printf("testParallel passed\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+/**
+ * @file testPolicyScheduler.cpp
+ * @brief 策略化调度器：环形任务队列、无锁单线程调度器、非默认策略上的无栈协程、
+ * 无锁调度器拒绝跨线程入队(blocking和迁移)、futex空闲策略不攒信号量和CPU占用，以及默认策略与Scheduler相同
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../Scheduler/Task.h"
+#include <assert.h>
+#include <string>
+#include <sys/resource.h>
+#include <type_traits>
+
+// 单线程调度器：环形任务队列，不加锁，空闲时忙等
+typedef BasicScheduler<RingQueue, NullMutex, SpinIdle> LocalScheduler;
+// 空闲时在futex上睡眠的多线程调度器
+typedef BasicScheduler<ListQueue, FutexMutex, FutexIdle> SleepyScheduler;
+
+static_assert(std::is_same_v<Scheduler, BasicScheduler<>>, "Scheduler should be the default policies");
+
+static std::string s_order;
+
+/**
+ * @brief 进程消耗的CPU时间(微秒)，包括用户态和内核态
+ */
+static uint64_t ProcessCpuUS()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec * 1000000ul + ru.ru_utime.tv_usec + ru.ru_stime.tv_sec * 1000000ul +
+           ru.ru_stime.tv_usec;
+}
+
+static void TestRingQueue()
+{
+    RingQueue<int> q(2);
+    for (int i = 0; i < 10; i++)
+    {
+        q.push_back(i);
+    }
+    assert(q.size() == 10 && q.front() == 0);
+    int out = -1;
+    bool skipped = false;
+    // 取出第一个奇数，跳过的0留在队首
+    assert(q.take([](int v) { return v % 2 == 1; }, out, skipped));
+    assert(out == 1 && skipped);
+    assert(q.size() == 9 && q.front() == 0);
+    std::string rest;
+    skipped = false;
+    while (q.take([](int) { return true; }, out, skipped))
+    {
+        rest += std::to_string(out);
+    }
+    assert(rest == "023456789" && !skipped && q.empty());
+    assert(!q.take([](int) { return true; }, out, skipped));
+}
+
+static void TestLocalScheduler()
+{
+    LocalScheduler sc(1, true, "local");
+    assert(LocalScheduler::GetThis() == &sc);
+    assert(Scheduler::GetThis() == nullptr);
+    s_order.clear();
+    sc.schedule([]() {
+        s_order += "a";
+        LocalScheduler::GetThis()->schedule([]() { s_order += "c"; });
+        LocalScheduler::GetThis()->scheduleNext([]() { s_order += "b"; });
+    });
+    // 协程让出后被放回同一个调度器的任务队列
+    sc.schedule(Coroutine::ptr(new Coroutine([]() {
+        s_order += "x";
+        Coroutine::GetThis()->reschedule();
+        s_order += "y";
+    })));
+    sc.scheduleAfter([]() { s_order += "t"; }, 5);
+    sc.start();
+    sc.stop();
+    printf("local order: %s, tasks %ld\n", s_order.c_str(), sc.getTaskCount());
+    assert(s_order == "abxcyt");
+    assert(sc.getTaskCount() == 6);
+}
+
+static task<void> Sleeper(char name)
+{
+    s_order += name;
+    co_await sleep_for(1);
+    s_order += name;
+}
+
+static void TestStackless()
+{
+    // sleep_for和spawn的默认参数通过SchedulerBase找到当前调度器，不要求是默认策略
+    LocalScheduler sc(1, true, "stackless");
+    s_order.clear();
+    spawn(Sleeper('a'), &sc);
+    sc.schedule([]() { spawn(Sleeper('b')); });
+    sc.start();
+    sc.stop();
+    printf("stackless order: %s\n", s_order.c_str());
+    assert(s_order == "abab");
+}
+
+static void TestSingleThreadOnly()
+{
+    static std::atomic<bool> ok;
+    static LocalScheduler *s_local = nullptr;
+    Scheduler other(1, false, "other");
+    other.start();
+    {
+        LocalScheduler sc(1, true, "single");
+        s_local = &sc;
+        ok = false;
+        sc.schedule(Coroutine::ptr(new Coroutine([&other]() {
+            // blocking()在本线程直接执行，BlockingPool的线程不会把协程放回来
+            int tid = ybb::GetThreadId();
+            int ran_on = SchedulerBase::blocking([]() { return ybb::GetThreadId(); });
+            bool stayed = ran_on == tid && s_local->getBlockingCount() == 0;
+            // 迁出后无法迁回，SchedulerSwitchScope什么也不做
+            {
+                SchedulerSwitchScope scope(other);
+                stayed = stayed && LocalScheduler::GetThis() == s_local;
+            }
+            ok = stayed && ybb::GetThreadId() == tid;
+        })));
+        sc.start();
+        sc.stop();
+        assert(ok);
+    }
+    other.stop();
+}
+
+static void TestSwitchToSingle()
+{
+    // 其他调度器的协程不能迁入
+    static std::atomic<bool> ok;
+    ok = false;
+    LocalScheduler local(1, true, "target");
+    Scheduler other(1, false, "origin");
+    other.start();
+    other.schedule([&local]() { ok = !SchedulerBase::switchTo(local) && Scheduler::GetThis() != nullptr; });
+    other.stop();
+    local.start();
+    local.stop();
+    assert(ok);
+}
+
+static void TestFutexIdleTokens()
+{
+    // 没有线程睡眠时的unpark不攒信号量，之后的park睡满超时
+    FutexIdle idle;
+    for (int i = 0; i < 100; i++)
+    {
+        idle.unpark();
+    }
+    uint64_t begin = ybb::GetCurrentUS();
+    idle.park(20 * 1000);
+    uint64_t slept = ybb::GetCurrentUS() - begin;
+    printf("park after 100 unparks: %lu us\n", slept);
+    assert(slept >= 15 * 1000);
+
+    // 睡眠中的线程被一次unpark唤醒，之后计数回到0
+    Thread waker([&idle]() {
+        while (!idle.m_parked.load())
+        {
+            usleep(100);
+        }
+        idle.unpark();
+    }, "waker");
+    begin = ybb::GetCurrentUS();
+    idle.park(10 * 1000 * 1000);
+    assert(ybb::GetCurrentUS() - begin < 5 * 1000 * 1000);
+    waker.join();
+    assert(idle.m_parked.load() == 0);
+}
+
+static void TestFutexIdle()
+{
+    const int kTasks = 100;
+    static std::atomic<int> done;
+    done = 0;
+    SleepyScheduler sc(4, false, "sleepy");
+    sc.start();
+    uint64_t begin_cpu = ProcessCpuUS();
+    uint64_t begin = ybb::GetCurrentUS();
+    usleep(200 * 1000);
+    uint64_t idle_cpu = ProcessCpuUS() - begin_cpu;
+    uint64_t wall = ybb::GetCurrentUS() - begin;
+    printf("4 idle threads: %lu us cpu in %lu us\n", idle_cpu, wall);
+    // 忙等的4个线程会占满CPU，睡眠的线程只在超时醒来时检查一下
+    assert(idle_cpu < wall / 4);
+
+    for (int i = 0; i < kTasks; i++)
+    {
+        sc.schedule([]() { ++done; });
+    }
+    while (done < kTasks)
+    {
+        usleep(100);
+    }
+    sc.stop();
+    assert(sc.getTaskCount() == kTasks);
+}
+
+int main()
+{
+    TestRingQueue();
+    TestLocalScheduler();
+    TestStackless();
+    TestSingleThreadOnly();
+    TestSwitchToSingle();
+    TestFutexIdleTokens();
+    TestFutexIdle();
+    printf("testPolicyScheduler passed\n");
+    return 0;
+}
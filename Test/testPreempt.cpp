@@ -0,0 +1,143 @@
+/**
+ * @file testPreempt.cpp
+ * @brief 时间片抢占：长任务在maybe_yield()处让出，或者在PreemptibleScope中被强制切走，
+ * 排在它后面的短任务不用等它跑完；PreemptibleScope中主动让出和强制切换混在一起也不会丢失协程
+ */
+#include "../Scheduler/Scheduler.h"
+#include <assert.h>
+#include <stdio.h>
+
+static const uint64_t kLongTaskMS = 200;
+static const uint64_t kSliceUS = 2000;
+
+static volatile uint64_t s_sink = 0;
+
+static void Spin()
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        s_sink = s_sink + i;
+    }
+}
+
+/**
+ * @brief 一个长任务加一个短任务，返回短任务开始执行时长任务已经跑了多久(毫秒)
+ * @param[in] forced 长任务是否只靠强制切换让出
+ */
+static uint64_t Run(Scheduler &sc, bool forced)
+{
+    static std::atomic<uint64_t> long_begin, short_begin, long_end;
+    long_begin = short_begin = long_end = 0;
+    sc.schedule([forced]() {
+        long_begin = ybb::GetCurrentMS();
+        if (forced)
+        {
+            PreemptibleScope scope;
+            while (ybb::GetCurrentMS() - long_begin < kLongTaskMS)
+            {
+                Spin();
+            }
+        }
+        else
+        {
+            while (ybb::GetCurrentMS() - long_begin < kLongTaskMS)
+            {
+                Spin();
+                maybe_yield();
+            }
+        }
+        long_end = ybb::GetCurrentMS();
+    });
+    sc.schedule([]() { short_begin = ybb::GetCurrentMS(); });
+    while (!long_end)
+    {
+        usleep(1000);
+    }
+    return short_begin - long_begin;
+}
+
+/**
+ * @brief 强制切换打开时，PreemptibleScope中的协程还不断地在maybe_yield()和reschedule()处主动让出
+ * @details 信号落在主动切换的中途时不能再强制切换，否则协程丢失(卡住)或者被放回两次
+ */
+static void TestYieldInScope()
+{
+    static const int kTasks = 4;
+    Scheduler sc(2, false, "forced_yield");
+    sc.setPreemption(kSliceUS / 4, true);
+    sc.start();
+    static std::atomic<int> finished;
+    static std::atomic<uint64_t> yields;
+    finished = 0;
+    yields = 0;
+    for (int i = 0; i < kTasks; i++)
+    {
+        sc.schedule([]() {
+            uint64_t begin = ybb::GetCurrentMS();
+            uint64_t last = ybb::GetCurrentUS();
+            PreemptibleScope scope;
+            while (ybb::GetCurrentMS() - begin < kLongTaskMS)
+            {
+                Spin();
+                maybe_yield();
+                // 主动让出的间隔和时间片差不多，两种切换都经常发生
+                if (ybb::GetCurrentUS() - last >= kSliceUS / 4)
+                {
+                    Coroutine::GetThis()->reschedule();
+                    ++yields;
+                    last = ybb::GetCurrentUS();
+                }
+            }
+            ++finished;
+        });
+    }
+    sc.stop();
+    printf("yield in scope: yields %lu, requests %ld preempted %ld forced %ld\n", yields.load(),
+           sc.getPreemptRequestCount(), sc.getPreemptCount(), sc.getForcedPreemptCount());
+    // 丢失的协程让stop()卡住；被放回两次的协程会被恢复两次，在Coroutine::resume的断言上失败
+    assert(finished == kTasks);
+    assert(sc.getForcedPreemptCount() > 0);
+}
+
+int main()
+{
+    {
+        // 不抢占时短任务要等长任务跑完
+        Scheduler sc(1, false, "nopreempt");
+        sc.start();
+        uint64_t wait = Run(sc, false);
+        sc.stop();
+        printf("no preemption: short task waited %lums, preempted %ld\n", wait, sc.getPreemptCount());
+        assert(wait >= kLongTaskMS);
+        assert(sc.getPreemptCount() == 0);
+    }
+    {
+        Scheduler sc(1, false, "preempt");
+        sc.setPreemption(kSliceUS);
+        sc.start();
+        uint64_t wait = Run(sc, false);
+        // 没有打开强制切换，PreemptibleScope不生效
+        uint64_t wait_scope = Run(sc, true);
+        sc.stop();
+        printf("maybe_yield: short task waited %lums, requests %ld preempted %ld forced %ld\n",
+               wait, sc.getPreemptRequestCount(), sc.getPreemptCount(), sc.getForcedPreemptCount());
+        assert(wait < kLongTaskMS / 2);
+        assert(wait_scope >= kLongTaskMS);
+        assert(sc.getPreemptCount() > 0);
+        assert(sc.getForcedPreemptCount() == 0);
+    }
+    {
+        Scheduler sc(2, false, "forced");
+        sc.setPreemption(kSliceUS, true);
+        sc.start();
+        uint64_t wait = Run(sc, true);
+        sc.stop();
+        printf("forced: short task waited %lums, requests %ld forced %ld\n",
+               wait, sc.getPreemptRequestCount(), sc.getForcedPreemptCount());
+        assert(wait < kLongTaskMS / 2);
+        assert(sc.getForcedPreemptCount() > 0);
+    }
+    TestYieldInScope();
+    printf("testPreempt ok\n");
+    return 0;
+}
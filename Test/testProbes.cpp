@@ -0,0 +1,58 @@
+/**
+ * @file testProbes.cpp
+ * @brief USDT探针：检查探针编译进了.note.stapsdt段，并且执行时不影响调度
+ * @details 挂载示例：bpftrace -p <pid> ../Trace/bpftrace/switch_rate.bt
+ */
+#include "../Scheduler/Scheduler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+int main()
+{
+    Scheduler sc(2, false, "probes");
+    sc.start();
+    for (int i = 0; i < 10; i++)
+    {
+        sc.schedule(Coroutine::ptr(new Coroutine([]() {
+            Scheduler::GetThis()->schedule(Coroutine::GetThis());
+            Coroutine::GetCurrent()->yield();
+        })));
+    }
+    sc.stop();
+
+    // popen里的/proc/self指向子进程，要用本进程的pid
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "readelf -n /proc/%d/exe 2>/dev/null", getpid());
+    FILE *fp = popen(cmd, "r");
+    if (!fp)
+    {
+        printf("readelf not available, skip\n");
+        return 0;
+    }
+    std::string notes;
+    char line[512];
+    while (fgets(line, sizeof(line), fp))
+    {
+        notes += line;
+    }
+    if (pclose(fp) != 0 || notes.empty())
+    {
+        printf("readelf not available, skip\n");
+        return 0;
+    }
+    const char *probes[] = {
+        "coroutine__create", "coroutine__resume", "coroutine__yield", "coroutine__term",
+        "scheduler__schedule", "scheduler__dequeue", "scheduler__idle__enter",
+        "scheduler__idle__exit", "scheduler__tickle"};
+    for (auto name : probes)
+    {
+        bool found = notes.find(std::string("Name: ") + name) != std::string::npos;
+        printf("%-24s %s\n", name, found ? "ok" : "missing");
+        assert(found);
+    }
+    assert(notes.find("Provider: ybb") != std::string::npos);
+    printf("testProbes ok\n");
+    return 0;
+}
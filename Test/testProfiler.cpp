@@ -0,0 +1,90 @@
+/**
+ * @file testProfiler.cpp
+ * @brief 采样分析器：两类打了标签的任务消耗不同的CPU，检查按标签汇总的结果
+ * @details 用法：./testProfiler [folded输出文件]，输出可以用flamegraph.pl生成火焰图
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../Trace/Profiler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string>
+
+static volatile uint64_t s_sink = 0;
+
+/**
+ * @brief 空转ms毫秒CPU时间
+ */
+__attribute__((noinline)) void BurnCpu(uint64_t ms)
+{
+    struct timespec begin, now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+    do
+    {
+        for (int i = 0; i < 10000; i++)
+        {
+            s_sink = s_sink + i;
+        }
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    } while ((now.tv_sec - begin.tv_sec) * 1000 + (now.tv_nsec - begin.tv_nsec) / 1000000 < (long)ms);
+}
+
+__attribute__((noinline)) void HotTask()
+{
+    BurnCpu(300);
+}
+
+__attribute__((noinline)) void ColdTask()
+{
+    BurnCpu(60);
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "/tmp/testProfiler.folded";
+    assert(Profiler::Start(997));
+    assert(!Profiler::Start(997));
+    {
+        Scheduler sc(1, false, "profiled");
+        sc.start();
+        sc.schedule(Coroutine::ptr(new Coroutine([]() {
+            Coroutine::GetCurrent()->setLabel("hot");
+            HotTask();
+        })));
+        sc.schedule(Coroutine::ptr(new Coroutine([]() {
+            Coroutine::GetCurrent()->setLabel("cold");
+            ColdTask();
+        })));
+        sc.stop();
+    }
+    Profiler::Stop();
+    printf("samples=%zu dropped=%zu\n", Profiler::SampleCount(), Profiler::Dropped());
+
+    uint64_t hot = 0, cold = 0, hot_with_frame = 0;
+    for (auto &i : Profiler::Folded())
+    {
+        if (i.first.compare(0, 4, "hot;") == 0)
+        {
+            hot += i.second;
+            if (i.first.find("HotTask") != std::string::npos && i.first.find("BurnCpu") != std::string::npos)
+            {
+                hot_with_frame += i.second;
+            }
+        }
+        else if (i.first.compare(0, 5, "cold;") == 0)
+        {
+            cold += i.second;
+        }
+    }
+    printf("hot=%lu (with frames %lu) cold=%lu\n", hot, hot_with_frame, cold);
+    assert(hot > 0 && cold > 0);
+    assert(hot > cold);
+    // 大部分样本都能回溯到任务函数
+    assert(hot_with_frame * 2 > hot);
+    for (auto &sample : Profiler::Samples())
+    {
+        assert(sample.depth >= 1 && sample.depth <= Profiler::kMaxFrames);
+    }
+    assert(Profiler::WriteFolded(path));
+    printf("testProfiler ok\n");
+    return 0;
+}
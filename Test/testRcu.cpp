@@ -0,0 +1,75 @@
+/**
+ * @file testRcu.cpp
+ * @brief SeqLock和RCU测试
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../Mutex/Rcu.h"
+#include "../Mutex/SeqLock.h"
+#include <assert.h>
+
+struct Config
+{
+    long a;
+    long b;
+    Config(long v) : a(v), b(v * 2) {}
+    ~Config()
+    {
+        // 释放后置为非法值，读者如果读到说明宽限期有问题
+        a = -1;
+        b = 1;
+    }
+};
+
+static RcuPtr<Config> s_config(new Config(0));
+static std::atomic<int> s_reads{0};
+
+struct Point
+{
+    long x;
+    long y;
+    long z;
+};
+
+static SeqLock<Point> s_point(Point{0, 0, 0});
+
+void reader()
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        RcuReadLock lock;
+        const Config *config = s_config.read();
+        assert(config->b == config->a * 2);
+
+        Point p = s_point.load();
+        assert(p.y == p.x + 1 || p.x == 0);
+        assert(p.z == p.x * 3);
+    }
+    ++s_reads;
+}
+
+int main()
+{
+    printf("main begin\n");
+    Scheduler sc(2, false, "rcu");
+    sc.start();
+    for (long v = 1; v <= 200; v++)
+    {
+        sc.schedule(&reader);
+        s_config.update(new Config(v));
+        s_point.store(Point{v, v + 1, v * 3});
+        if (v % 50 == 0)
+        {
+            // 非工作线程上的读者
+            RcuReadLock lock;
+            assert(s_config.read()->a == v);
+        }
+    }
+    sc.stop();
+
+    Rcu::Barrier();
+    printf("reads %d, pending callbacks %lu\n", s_reads.load(), Rcu::PendingCallbacks());
+    assert(s_reads == 200);
+    assert(Rcu::PendingCallbacks() == 0);
+    printf("main end\n");
+    return 0;
+}
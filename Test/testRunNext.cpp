@@ -0,0 +1,68 @@
+/**
+ * @file testRunNext.cpp
+ * @brief run-next槽测试：唤醒者放入run-next槽的任务先于普通任务执行，
+ * use_caller的线程在run()之外不占用工作线程槽
+ */
+#include "../Scheduler/Scheduler.h"
+#include <assert.h>
+#include <atomic>
+#include <string>
+
+static std::string s_order;
+
+void task_b() { s_order += "b"; }
+void task_c() { s_order += "c"; }
+void task_d() { s_order += "d"; }
+
+void task_a()
+{
+    s_order += "a";
+    Scheduler::GetThis()->schedule(task_b);
+    Scheduler::GetThis()->scheduleNext(task_c);
+    // d把c挤出run-next槽，c排到任务队列末尾
+    Scheduler::GetThis()->scheduleNext(task_d);
+}
+
+/**
+ * @brief 暴露当前线程的工作线程槽
+ */
+class SlotProbe : public Scheduler
+{
+public:
+    using Scheduler::Scheduler;
+
+    bool hasSlot() { return currentSlot() != nullptr; }
+};
+
+/**
+ * @brief use_caller的线程在run()之外没有工作线程槽，scheduleNext()不能占用已启动工作线程的槽
+ */
+static void TestCallerSlot()
+{
+    SlotProbe sc(2, true, "probe");
+    assert(!sc.hasSlot());
+    sc.start();
+    assert(!sc.hasSlot());
+    static std::atomic<bool> worker_has_slot;
+    worker_has_slot = false;
+    sc.schedule([&sc]() { worker_has_slot = sc.hasSlot(); });
+    sc.stop();
+    assert(worker_has_slot);
+    // run()返回后又回到没有槽的状态
+    assert(!sc.hasSlot());
+}
+
+int main()
+{
+    printf("main begin\n");
+    TestCallerSlot();
+    Scheduler sc;
+    sc.schedule(task_a);
+    sc.start();
+    sc.stop();
+    printf("order: %s\n", s_order.c_str());
+    assert(s_order == "adbc");
+    assert(sc.getTaskCount() == 4);
+    printf("main end\n");
+    return 0;
+}
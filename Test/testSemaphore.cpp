@@ -0,0 +1,106 @@
+/**
+ * @file testSemaphore.cpp
+ * @brief 信号量：多生产者多消费者的计数不丢不多、waitFor超时，
+ * 拿到计数后马上析构信号量、Thread创建后马上析构，notify()在加法之后不再访问信号量
+ */
+#include "../Mutex/Mutex.h"
+#include "../Thread/Threads.h"
+#include "../util.h"
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+static const int kThreads = 4;
+static const int kOps = 20000;
+static const int kShortLived = 2000;
+
+static void TestCounting()
+{
+    Semaphore sem;
+    std::atomic<int> taken = {0};
+    std::vector<Thread::ptr> thrs;
+    for (int i = 0; i < kThreads; i++)
+    {
+        thrs.push_back(Thread::ptr(new Thread(
+            [&sem, &taken]() {
+                for (int k = 0; k < kOps; k++)
+                {
+                    sem.wait();
+                    ++taken;
+                }
+            },
+            "consumer_" + std::to_string(i))));
+        thrs.push_back(Thread::ptr(new Thread(
+            [&sem]() {
+                for (int k = 0; k < kOps; k++)
+                {
+                    sem.notify();
+                }
+            },
+            "producer_" + std::to_string(i))));
+    }
+    for (auto &i : thrs)
+    {
+        i->join();
+    }
+    assert(taken == kThreads * kOps);
+    assert(!sem.tryWait());
+}
+
+static void TestTimeout()
+{
+    Semaphore sem;
+    uint64_t begin = ybb::GetCurrentUS();
+    assert(!sem.waitFor(5000));
+    assert(ybb::GetCurrentUS() - begin >= 5000);
+    // 超时撤销登记之后，notify()不会唤醒已经不在等的线程，计数留给下一次获取
+    sem.notify();
+    assert(sem.waitFor(5000));
+    assert(!sem.tryWait());
+}
+
+static void TestDestroyAfterWait()
+{
+    // 生产者notify()之后，等待的一方马上析构信号量
+    std::vector<Semaphore *> sems(kShortLived);
+    for (auto &i : sems)
+    {
+        i = new Semaphore;
+    }
+    Thread producer(
+        [&sems]() {
+            for (auto i : sems)
+            {
+                i->notify();
+            }
+        },
+        "producer");
+    for (auto &i : sems)
+    {
+        i->wait();
+        delete i;
+        i = nullptr;
+    }
+    producer.join();
+
+    // 子线程启动时在Thread的信号量上notify()，析构等到它启动就可以释放Thread
+    std::atomic<int> ran = {0};
+    for (int i = 0; i < kShortLived; i++)
+    {
+        Thread t([&ran]() { ++ran; }, "short_lived");
+    }
+    while (ran < kShortLived)
+    {
+        usleep(1000);
+    }
+}
+
+int main()
+{
+    printf("main begin\n");
+    TestCounting();
+    TestTimeout();
+    TestDestroyAfterWait();
+    printf("main end\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file testSharded.cpp
+ * @brief 分片调度器：submit_to的结果和异常、跨分片投递、入队环满时的溢出和顺序、stop()等所有任务执行完，
+ * 分片上的任务让出、blocking()、sleep_for之后回到原来的分片
+ */
+#include "../Scheduler/ShardedScheduler.h"
+#include "../Scheduler/Task.h"
+#include <assert.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <unistd.h>
+
+static const int kHops = 10000;
+static const int kBurst = 1000;
+
+static ShardedScheduler *s_sc = nullptr;
+static std::atomic<int> s_hops;
+static std::atomic<bool> s_slept;
+
+/**
+ * @brief 在分片之间轮流传递，每一跳投递到下一个分片
+ */
+static void Hop(int left)
+{
+    assert(ShardedScheduler::GetThis() == s_sc);
+    ++s_hops;
+    if (left > 0)
+    {
+        size_t next = (ShardedScheduler::GetShardId() + 1) % s_sc->getShardCount();
+        s_sc->post(next, [left]() { Hop(left - 1); });
+    }
+}
+
+static task<void> SleepOnShard()
+{
+    uint64_t begin = ybb::GetCurrentMS();
+    co_await sleep_for(5);
+    assert(ybb::GetCurrentMS() - begin >= 5);
+    assert(ShardedScheduler::GetShardId() == 1);
+    s_slept = true;
+}
+
+int main()
+{
+    {
+        ShardedScheduler sc(3, "sharded");
+        s_sc = &sc;
+        sc.start();
+        assert(ShardedScheduler::GetShardId() == -1);
+
+        // 外部线程提交，future拿结果和异常
+        for (size_t i = 0; i < sc.getShardCount(); i++)
+        {
+            std::future<int> f = sc.submit_to(i, []() { return ShardedScheduler::GetShardId(); });
+            assert(f.get() == (int)i);
+        }
+        std::future<void> err = sc.submit_to(1, []() { throw std::runtime_error("shard failed"); });
+        bool caught = false;
+        try
+        {
+            err.get();
+        }
+        catch (const std::runtime_error &)
+        {
+            caught = true;
+        }
+        assert(caught);
+
+        // 跨分片传递，stop()要等整条链走完
+        s_hops = 0;
+        sc.post(0, []() { Hop(kHops); });
+        sc.stop();
+        printf("hops %d, tasks %lu, remote %lu\n", s_hops.load(), sc.getTaskCount(), sc.getRemoteTaskCount());
+        assert(s_hops == kHops + 1);
+        assert(sc.getRemoteTaskCount() >= (uint64_t)kHops);
+    }
+    {
+        // 入队环只有4个位置，一次投递一批，多出来的进溢出队列，顺序不变
+        ShardedScheduler sc(2, "overflow", true, 4);
+        sc.start();
+        static std::vector<int> received;
+        received.clear();
+        sc.post(0, [&sc]() {
+            for (int i = 0; i < kBurst; i++)
+            {
+                sc.post(1, [i]() { received.push_back(i); });
+            }
+        });
+        sc.stop();
+        printf("overflowed %lu of %d\n", sc.getOverflowCount(), kBurst);
+        assert(sc.getOverflowCount() > 0);
+        assert(received.size() == (size_t)kBurst);
+        for (int i = 0; i < kBurst; i++)
+        {
+            assert(received[i] == i);
+        }
+    }
+    {
+        // 分片上的任务在协程中执行：让出、挂起等阻塞调用期间分片继续执行别的任务，之后回到原来的分片
+        ShardedScheduler sc(2, "coroutine");
+        sc.start();
+        static std::atomic<bool> finished, other_ran;
+        finished = other_ran = false;
+        s_slept = false;
+        sc.post(1, [&sc]() {
+            pid_t tid = ybb::GetThreadId();
+            Coroutine::GetThis()->reschedule();
+            assert(ybb::GetThreadId() == tid && ShardedScheduler::GetShardId() == 1);
+
+            sc.post(1, []() { other_ran = true; });
+            pid_t blocking_tid = SchedulerBase::blocking([]() {
+                usleep(10 * 1000);
+                return ybb::GetThreadId();
+            });
+            assert(blocking_tid != tid);
+            assert(ybb::GetThreadId() == tid && ShardedScheduler::GetShardId() == 1);
+            assert(other_ran);
+
+            spawn(SleepOnShard());
+            finished = true;
+        });
+        sc.stop();
+        assert(finished && s_slept);
+    }
+    printf("testSharded passed\n");
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * @file testShardedCounter.cpp
+ * @brief 分片计数器和分段ID分配器测试：多线程分配的ID唯一且在段内连续递增，
+ * 跨线程加减后load()是精确值，approx()在kApproxIntervalUS内不刷新、之后刷新
+ */
+#include "../Mutex/ShardedCounter.h"
+#include "../Thread/Threads.h"
+#include <algorithm>
+#include <assert.h>
+#include <unistd.h>
+#include <vector>
+
+static const int kThreads = 8;
+static const int kIdsPerThread = 10000;
+static const int kOps = 100000;
+
+struct TestIdTag
+{
+};
+static const uint64_t kBlockSize = 64;
+typedef IdBlockAllocator<TestIdTag, kBlockSize> TestIdAllocator;
+
+static void TestIds()
+{
+    std::vector<std::vector<uint64_t>> ids(kThreads);
+    std::vector<Thread::ptr> thrs;
+    for (int i = 0; i < kThreads; i++)
+    {
+        std::vector<uint64_t> *mine = &ids[i];
+        thrs.push_back(Thread::ptr(new Thread(
+            [mine]() {
+                for (int k = 0; k < kIdsPerThread; k++)
+                {
+                    mine->push_back(TestIdAllocator::Next());
+                }
+            },
+            "id_" + std::to_string(i))));
+    }
+    std::vector<uint64_t> all;
+    for (int i = 0; i < kThreads; i++)
+    {
+        thrs[i]->join();
+        const std::vector<uint64_t> &mine = ids[i];
+        for (size_t k = 1; k < mine.size(); k++)
+        {
+            if (mine[k] % kBlockSize)
+            {
+                // 段内连续递增
+                assert(mine[k] == mine[k - 1] + 1);
+            }
+            else
+            {
+                // 上一段用完才申请新段，新段在上一段之后
+                assert(mine[k - 1] % kBlockSize == kBlockSize - 1 && mine[k] > mine[k - 1]);
+            }
+        }
+        all.insert(all.end(), mine.begin(), mine.end());
+    }
+    std::sort(all.begin(), all.end());
+    assert(std::adjacent_find(all.begin(), all.end()) == all.end());
+    assert(all.size() == (size_t)kThreads * kIdsPerThread);
+}
+
+static void TestExact()
+{
+    ShardedCounter counter;
+    std::vector<Thread::ptr> thrs;
+    // 一半线程加、一半线程减，加减落在不同的分片上
+    for (int i = 0; i < kThreads; i++)
+    {
+        bool up = i % 2 == 0;
+        thrs.push_back(Thread::ptr(new Thread(
+            [&counter, up]() {
+                for (int k = 0; k < kOps; k++)
+                {
+                    up ? counter.inc() : counter.dec();
+                }
+                if (up)
+                {
+                    counter.add(3);
+                }
+            },
+            "counter_" + std::to_string(i))));
+    }
+    for (auto &i : thrs)
+    {
+        i->join();
+    }
+    assert(counter.load() == (kThreads + 1) / 2 * 3);
+
+    // 在一个线程加、另一个线程减
+    thrs.clear();
+    thrs.push_back(Thread::ptr(new Thread([&counter]() { counter.add(kOps); }, "counter_add")));
+    thrs[0]->join();
+    thrs.push_back(Thread::ptr(new Thread([&counter]() { counter.add(-kOps); }, "counter_sub")));
+    thrs[1]->join();
+    assert(counter.load() == (kThreads + 1) / 2 * 3);
+}
+
+static uint64_t CoarseUS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
+
+static void TestApprox()
+{
+    ShardedCounter counter;
+    counter.add(5);
+    // 第一次读取时刷新
+    assert(counter.approx() == 5);
+    usleep(ShardedCounter::kApproxIntervalUS * 5);
+    int stale = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        // 上次刷新已经超过缓存时间，这次读取刷新，缓存时间不早于begin
+        uint64_t begin = CoarseUS();
+        int64_t before = counter.approx();
+        assert(before == counter.load());
+        counter.inc();
+        int64_t value = counter.approx();
+        // approx()与这里用同一个时钟，时钟还没走过kApproxIntervalUS时一定是旧值
+        if (CoarseUS() - begin < ShardedCounter::kApproxIntervalUS)
+        {
+            assert(value == before);
+            ++stale;
+        }
+        // 超过缓存时间后刷新为精确值
+        usleep(ShardedCounter::kApproxIntervalUS * 5);
+        while (CoarseUS() - begin < ShardedCounter::kApproxIntervalUS * 2)
+        {
+            usleep(1000);
+        }
+        assert(counter.approx() == before + 1);
+    }
+    printf("approx stale %d/100\n", stale);
+    assert(stale > 0);
+}
+
+int main()
+{
+    printf("main begin\n");
+    TestIds();
+    TestExact();
+    TestApprox();
+    printf("main end\n");
+    return 0;
+}
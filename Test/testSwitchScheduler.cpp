@@ -0,0 +1,122 @@
+/**
+ * @file testSwitchScheduler.cpp
+ * @brief 协程在调度器之间迁移：CPU调度器和IO调度器之间接力执行、SchedulerSwitchScope迁回、
+ * 迁出期间原调度器的stop()等协程回来，以及use_caller线程上让出后当前协程是调度协程
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../Scheduler/Task.h"
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static const int kRequests = 200;
+
+static Scheduler *s_cpu = nullptr;
+static Scheduler *s_io = nullptr;
+static std::atomic<int> s_ioThread;
+static std::atomic<int> s_done;
+static std::atomic<bool> s_failed;
+
+static void Check(bool ok)
+{
+    if (!ok)
+    {
+        s_failed = true;
+    }
+}
+
+/**
+ * @brief 一个请求：在CPU调度器上解析，迁到IO调度器上读写，中间临时回CPU调度器计算一次，最后回到CPU调度器
+ */
+static void Request(int id)
+{
+    Coroutine *self = Coroutine::GetCurrent();
+    int parsed = id * 2;
+    Check(Scheduler::GetThis() == s_cpu);
+    Check(SchedulerBase::switchTo(*s_io));
+    Check(Scheduler::GetThis() == s_io && ybb::GetThreadId() == s_ioThread);
+    Check(Coroutine::GetCurrent() == self && parsed == id * 2);
+    {
+        SchedulerSwitchScope scope(*s_cpu);
+        Check(Scheduler::GetThis() == s_cpu && ybb::GetThreadId() != s_ioThread);
+        Check(s_io->getAwayCount() > 0);
+    }
+    Check(Scheduler::GetThis() == s_io && ybb::GetThreadId() == s_ioThread);
+    Check(SchedulerBase::switchTo(*s_cpu));
+    Check(Scheduler::GetThis() == s_cpu);
+    ++s_done;
+}
+
+static task<void> CheckStackless(std::atomic<bool> *ok)
+{
+    // 无栈协程在调度协程的栈上执行，不能迁移
+    *ok = Coroutine::GetCurrent() == Scheduler::GetMainCoroutine() && !SchedulerBase::switchTo(*Scheduler::GetThis());
+    co_return;
+}
+
+int main()
+{
+    {
+        Scheduler cpu(2, false, "cpu");
+        Scheduler io(1, false, "io");
+        s_cpu = &cpu;
+        s_io = &io;
+        cpu.start();
+        io.start();
+        // 不在调度器的协程中不迁移
+        assert(!SchedulerBase::switchTo(io));
+        io.schedule([]() { s_ioThread = ybb::GetThreadId(); });
+        while (!s_ioThread)
+        {
+            usleep(100);
+        }
+        for (int i = 0; i < kRequests; i++)
+        {
+            cpu.schedule([i]() { Request(i); });
+        }
+        while (s_done < kRequests)
+        {
+            usleep(1000);
+        }
+        cpu.stop();
+        io.stop();
+        printf("%d requests, cpu tasks %ld, io tasks %ld\n", s_done.load(), cpu.getTaskCount(), io.getTaskCount());
+        assert(!s_failed);
+        assert(io.getTaskCount() >= kRequests);
+        assert(cpu.getAwayCount() == 0 && io.getAwayCount() == 0);
+    }
+    {
+        // 迁出去的协程回来之前原调度器不能停止
+        Scheduler origin(1, false, "origin");
+        Scheduler other(1, false, "other");
+        origin.start();
+        other.start();
+        static std::atomic<bool> finished;
+        finished = false;
+        origin.schedule([&other]() {
+            {
+                SchedulerSwitchScope scope(other);
+                usleep(100 * 1000);
+            }
+            finished = Scheduler::GetThis() != nullptr;
+        });
+        while (origin.getAwayCount() == 0)
+        {
+            usleep(1000);
+        }
+        origin.stop();
+        assert(finished);
+        other.stop();
+    }
+    {
+        Scheduler sc(1, true, "caller");
+        static std::atomic<bool> ok;
+        sc.schedule(Coroutine::ptr(new Coroutine([]() { Coroutine::GetThis()->reschedule(); })));
+        spawn(CheckStackless(&ok), &sc);
+        sc.start();
+        sc.stop();
+        assert(ok);
+    }
+    printf("testSwitchScheduler passed\n");
+    return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file testTask.cpp
+ * @brief 无栈协程task<T>测试
+ */
+#include "../Scheduler/Task.h"
+#include <unistd.h>
+#include <assert.h>
+
+static int s_pipe[2];
+
+task<int> add(int a, int b)
+{
+    co_return a + b;
+}
+
+task<int> sum(int n)
+{
+    int total = 0;
+    for (int i = 0; i < n; i++)
+    {
+        total += co_await add(i, 1);
+    }
+    co_return total;
+}
+
+task<void> test_yield(int id)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        printf("test_yield %d round %d\n", id, i);
+        co_await Scheduler::GetThis()->yield();
+    }
+}
+
+task<void> test_sum()
+{
+    int total = co_await sum(10);
+    printf("sum = %d\n", total);
+    assert(total == 55);
+}
+
+task<void> test_sleep()
+{
+    uint64_t begin = ybb::GetCurrentMS();
+    co_await sleep_for(50);
+    uint64_t cost = ybb::GetCurrentMS() - begin;
+    printf("sleep cost %lu ms\n", cost);
+    assert(cost >= 50);
+    write(s_pipe[1], "x", 1);
+}
+
+task<void> test_readable()
+{
+    co_await fd_readable(s_pipe[0]);
+    char c;
+    read(s_pipe[0], &c, 1);
+    printf("pipe readable, read '%c'\n", c);
+}
+
+int main()
+{
+    printf("main begin\n");
+    pipe(s_pipe);
+
+    Scheduler sc;
+    sc.start();
+    spawn(test_readable(), &sc);
+    spawn(test_sleep(), &sc);
+    spawn(test_sum(), &sc);
+    spawn(test_yield(1), &sc);
+    spawn(test_yield(2), &sc);
+    sc.stop();
+
+    close(s_pipe[0]);
+    close(s_pipe[1]);
+    printf("main end\n");
+    return 0;
+}
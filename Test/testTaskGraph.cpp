@@ -0,0 +1,179 @@
+/**
+ * @file testTaskGraph.cpp
+ * @brief 任务图：节点在所有前驱完成之后才执行、重复执行、链上的后继直接执行、关键路径、
+ * 异常和环，run()返回后马上析构图，以及在调度器协程中执行时挂起等待
+ */
+#include "../Scheduler/TaskGraph.h"
+#include <assert.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <unistd.h>
+
+static const int kRuns = 5;
+static const int kChain = 100;
+static const int kShortLived = 2000;
+
+// 每个节点开始和结束时各取一个全局序号
+static std::atomic<int> s_seq;
+
+struct Stamp
+{
+    std::atomic<int> begin = {0};
+    std::atomic<int> end = {0};
+};
+
+static void TestDependencies(Scheduler &sc)
+{
+    // a -> b(20ms) -> d -> e
+    // a -> c(1ms)  -> d
+    TaskGraph graph("diamond");
+    Stamp stamps[5];
+    auto node = [&](int i, uint64_t ms) {
+        return graph.addNode(
+            [&stamps, i, ms]() {
+                stamps[i].begin = ++s_seq;
+                usleep(ms * 1000);
+                stamps[i].end = ++s_seq;
+            },
+            std::string(1, 'a' + i));
+    };
+    TaskGraph::NodeId a = node(0, 5), b = node(1, 20), c = node(2, 1), d = node(3, 5), e = node(4, 0);
+    graph.addEdge(a, b);
+    graph.addEdge(a, c);
+    graph.addEdge(b, d);
+    graph.addEdge(c, d);
+    graph.addEdge(d, e);
+    for (int run = 0; run < kRuns; run++)
+    {
+        graph.run(sc);
+        assert(stamps[b].begin > stamps[a].end && stamps[c].begin > stamps[a].end);
+        assert(stamps[d].begin > stamps[b].end && stamps[d].begin > stamps[c].end);
+        assert(stamps[e].begin > stamps[d].end);
+    }
+    const TaskGraph::RunStats &stats = graph.getLastRun();
+    printf("diamond: wall %luus, work %luus, critical %luus: %s\n", stats.wallUS, stats.workUS, stats.criticalPathUS,
+           graph.criticalPathString().c_str());
+    assert(graph.getRunCount() == kRuns);
+    assert((stats.criticalPath == std::vector<TaskGraph::NodeId>{a, b, d, e}));
+    assert(stats.criticalPathUS >= 30 * 1000 && stats.criticalPathUS <= stats.wallUS);
+    assert(stats.workUS >= stats.criticalPathUS);
+}
+
+static void TestChain(Scheduler &sc)
+{
+    // 每个节点完成时只有一个后继就绪，都在同一个工作线程上直接执行
+    TaskGraph graph("chain");
+    std::vector<int> order;
+    TaskGraph::NodeId prev = 0;
+    for (int i = 0; i < kChain; i++)
+    {
+        TaskGraph::NodeId id = graph.addNode([&order, i]() { order.push_back(i); });
+        if (i)
+        {
+            graph.addEdge(prev, id);
+        }
+        prev = id;
+    }
+    for (int run = 0; run < kRuns; run++)
+    {
+        order.clear();
+        graph.run(sc);
+        assert(order.size() == (size_t)kChain);
+        for (int i = 0; i < kChain; i++)
+        {
+            assert(order[i] == i);
+        }
+        assert(graph.getLastRun().inlineCount == (size_t)kChain - 1);
+        assert(graph.getLastRun().criticalPath.size() == (size_t)kChain);
+    }
+}
+
+static void TestErrors(Scheduler &sc)
+{
+    TaskGraph graph("errors");
+    static std::atomic<bool> after_ran;
+    after_ran = false;
+    TaskGraph::NodeId bad = graph.addNode([]() { throw std::runtime_error("stage failed"); });
+    TaskGraph::NodeId after = graph.addNode([]() { after_ran = true; });
+    graph.addEdge(bad, after);
+    bool caught = false;
+    try
+    {
+        graph.run(sc);
+    }
+    catch (const std::runtime_error &)
+    {
+        caught = true;
+    }
+    assert(caught && !after_ran);
+
+    TaskGraph cycle("cycle");
+    TaskGraph::NodeId x = cycle.addNode([]() {});
+    TaskGraph::NodeId y = cycle.addNode([]() {});
+    cycle.addEdge(x, y);
+    cycle.addEdge(y, x);
+    caught = false;
+    try
+    {
+        cycle.run(sc);
+    }
+    catch (const std::logic_error &)
+    {
+        caught = true;
+    }
+    assert(caught);
+
+    // 空图直接返回
+    TaskGraph empty("empty");
+    empty.run(sc);
+    assert(empty.getLastRun().criticalPath.empty());
+}
+
+static void TestDestroyAfterRun(Scheduler &sc)
+{
+    // 最后一个节点完成后run()马上返回、图马上析构，完成的一方之后不能再访问图
+    std::atomic<int> count = {0};
+    for (int i = 0; i < kShortLived; i++)
+    {
+        TaskGraph *graph = new TaskGraph("short");
+        for (int k = 0; k < 4; k++)
+        {
+            graph->addNode([&count]() { ++count; });
+        }
+        graph->run(sc);
+        delete graph;
+    }
+    assert(count == kShortLived * 4);
+}
+
+int main()
+{
+    {
+        // 外部线程执行，在futex上等待
+        Scheduler sc(3, false, "graph");
+        sc.start();
+        TestDependencies(sc);
+        TestChain(sc);
+        TestErrors(sc);
+        TestDestroyAfterRun(sc);
+        sc.stop();
+    }
+    {
+        // 在唯一的工作线程的协程中执行，等待时挂起，工作线程继续执行节点
+        Scheduler sc(1, false, "graph1");
+        sc.start();
+        static std::atomic<bool> finished;
+        finished = false;
+        sc.schedule([]() {
+            TestDependencies(*Scheduler::GetThis());
+            TestChain(*Scheduler::GetThis());
+            TestErrors(*Scheduler::GetThis());
+            TestDestroyAfterRun(*Scheduler::GetThis());
+            finished = true;
+        });
+        sc.stop();
+        assert(finished);
+    }
+    printf("testTaskGraph passed\n");
+    return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file testTracer.cpp
+ * @brief 调度时间线追踪：关闭时不记录，打开时记录事件并导出Chrome trace JSON，
+ * 排队的开始和结束事件成对，入队事件带上入队的工作线程
+ * @details 用法：./testTracer [输出文件]，输出文件可以用ui.perfetto.dev打开
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../Trace/Tracer.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string>
+
+static const int kCoroutines = 20;
+static const int kYields = 5;
+
+static size_t CountOf(const std::string &s, const std::string &sub)
+{
+    size_t n = 0;
+    for (size_t pos = s.find(sub); pos != std::string::npos; pos = s.find(sub, pos + 1))
+    {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief 导出的每个事件占一行，统计同时包含a和b的行数
+ */
+static size_t CountLines(const std::string &s, const std::string &a, const std::string &b)
+{
+    size_t n = 0;
+    for (size_t begin = 0; begin < s.size();)
+    {
+        size_t end = s.find('\n', begin);
+        if (end == std::string::npos)
+        {
+            end = s.size();
+        }
+        std::string line = s.substr(begin, end - begin);
+        if (line.find(a) != std::string::npos && line.find(b) != std::string::npos)
+        {
+            n++;
+        }
+        begin = end + 1;
+    }
+    return n;
+}
+
+static std::string ReadFile(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "r");
+    std::string json;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+        json.append(buf, n);
+    }
+    fclose(fp);
+    return json;
+}
+
+/**
+ * @brief 协程每次运行后重新入队，另外调度一些函数任务
+ */
+static void RunTasks(const char *name)
+{
+    Scheduler sc(2, false, name);
+    sc.start();
+    for (int i = 0; i < kCoroutines; i++)
+    {
+        sc.schedule(Coroutine::ptr(new Coroutine([]() {
+            for (int j = 0; j < kYields; j++)
+            {
+                Scheduler::GetThis()->schedule(Coroutine::GetThis());
+                Coroutine::GetCurrent()->yield();
+            }
+        })));
+        sc.schedule([]() {});
+    }
+    sc.stop();
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "/tmp/testTracer.json";
+
+    // 关闭时调度器的埋点不记录，导出的事件为空
+    RunTasks("untraced");
+    assert(Tracer::Count() == 0);
+    assert(Tracer::WriteChromeTrace(path));
+    assert(ReadFile(path) == "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n]}\n");
+
+    Tracer::Start();
+    RunTasks("traced");
+    Tracer::Stop();
+    printf("events=%zu\n", Tracer::Count());
+    assert(Tracer::WriteChromeTrace(path));
+    std::string json = ReadFile(path);
+
+    // 每个协程运行kYields+1次，每次运行前都在任务队列里排过队；函数任务没有排队事件
+    size_t runs = CountOf(json, "\"cat\":\"run\"");
+    size_t func_runs = CountOf(json, "\"name\":\"run func\"");
+    size_t queued_begin = CountOf(json, "\"ph\":\"b\"");
+    size_t queued_end = CountOf(json, "\"ph\":\"e\"");
+    printf("runs=%zu func=%zu queued=%zu/%zu\n", runs, func_runs, queued_begin, queued_end);
+    assert(func_runs == kCoroutines);
+    assert(runs == kCoroutines * (kYields + 2));
+    assert(queued_begin == kCoroutines * (kYields + 1) && queued_end == queued_begin);
+    // 主线程入队的事件不属于任何工作线程，协程在工作线程上重新入队时带上工作线程序号
+    size_t from_main = CountLines(json, "\"ph\":\"b\"", "\"worker\":-1");
+    printf("queued from main=%zu\n", from_main);
+    assert(from_main == kCoroutines);
+    assert(CountOf(json, "\"ph\":\"B\"") == CountOf(json, "\"ph\":\"E\""));
+    assert(json.find("thread_name") != std::string::npos);
+    assert(json.find("traced_") != std::string::npos);
+    assert(json.compare(json.size() - 3, 3, "]}\n") == 0);
+    Tracer::Clear();
+    printf("testTracer ok\n");
+    return 0;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file testTransfer.cpp
+ * @brief 协程直接切换(transfer_to/yield_to)测试
+ */
+#include "../Scheduler/Scheduler.h"
+#include "../util.h"
+#include <assert.h>
+
+static const int kRounds = 100000;
+
+static Coroutine::ptr s_producer;
+static Coroutine::ptr s_consumer;
+static int s_value = -1;
+static bool s_done = false;
+static long s_sum = 0;
+
+/**
+ * @brief 生产者每产生一个值就直接切换给消费者
+ */
+void producer()
+{
+    for (int i = 0; i < kRounds; i++)
+    {
+        s_value = i;
+        Coroutine::GetThis()->transfer_to(s_consumer);
+    }
+    s_done = true;
+    // 最后一次让出时把自己放回调度队列，让消费者先结束
+    Coroutine::GetThis()->yield_to(s_consumer);
+    printf("producer end\n");
+}
+
+/**
+ * @brief 消费者取走值后直接切回生产者
+ */
+void consumer()
+{
+    while (!s_done)
+    {
+        s_sum += s_value;
+        Coroutine::GetThis()->transfer_to(s_producer);
+    }
+    printf("consumer end\n");
+}
+
+int main()
+{
+    printf("main begin\n");
+    Scheduler sc;
+    s_producer.reset(new Coroutine(producer));
+    s_consumer.reset(new Coroutine(consumer));
+    sc.schedule(s_producer);
+
+    uint64_t begin = ybb::GetCurrentUS();
+    sc.start();
+    sc.stop();
+    uint64_t cost = ybb::GetCurrentUS() - begin;
+
+    printf("sum = %ld, %d hops in %lu us\n", s_sum, kRounds * 2, cost);
+    assert(s_sum == (long)kRounds * (kRounds - 1) / 2);
+    assert(s_producer->getState() == Coroutine::TERM);
+    assert(s_consumer->getState() == Coroutine::TERM);
+    s_producer.reset();
+    s_consumer.reset();
+    printf("main end\n");
+    return 0;
+}
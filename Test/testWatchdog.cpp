@@ -0,0 +1,81 @@
+/**
+ * @file testWatchdog.cpp
+ * @brief 卡住的工作线程监控：唯一的工作线程被阻塞的系统调用占住时，
+ * 监控线程补充一个工作线程把排在后面的任务跑完，卡住的任务结束后补充线程退出
+ */
+#include "../Scheduler/Scheduler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static const uint64_t kStallMS = 50;
+static const uint64_t kBlockMS = 400;
+static const int kShortTasks = 10;
+
+int main()
+{
+    {
+        // 不监控时短任务要等阻塞的任务结束
+        Scheduler sc(1, false, "nowatch");
+        sc.start();
+        static std::atomic<uint64_t> begin, last_done;
+        begin = ybb::GetCurrentMS();
+        sc.schedule([]() { usleep(kBlockMS / 4 * 1000); });
+        sc.schedule([]() { last_done = ybb::GetCurrentMS(); });
+        sc.stop();
+        printf("no watchdog: short task done after %lums\n", last_done - begin);
+        assert(last_done - begin >= kBlockMS / 4);
+        assert(sc.getStallCount() == 0 && sc.getCompensatingSpawned() == 0);
+    }
+    {
+        Scheduler sc(1, false, "watch");
+        sc.setWatchdog(kStallMS, 1);
+        sc.start();
+        static std::atomic<uint64_t> begin, blocked_done, last_done;
+        static std::atomic<int> done;
+        begin = ybb::GetCurrentMS();
+        blocked_done = last_done = 0;
+        done = 0;
+        sc.schedule([]() {
+            usleep(kBlockMS * 1000);
+            blocked_done = ybb::GetCurrentMS();
+        });
+        for (int i = 0; i < kShortTasks; i++)
+        {
+            sc.schedule([]() {
+                if (++done == kShortTasks)
+                {
+                    last_done = ybb::GetCurrentMS();
+                }
+            });
+        }
+        while (!blocked_done)
+        {
+            usleep(1000);
+        }
+        printf("watchdog: short tasks done after %lums, blocked task after %lums, stalls %lu spawned %lu\n",
+               last_done ? last_done - begin : 0, blocked_done - begin, sc.getStallCount(),
+               sc.getCompensatingSpawned());
+        // 短任务由补充线程执行，不用等阻塞的任务
+        assert(last_done && last_done < blocked_done);
+        assert(sc.getStallCount() == 1);
+        assert(sc.getCompensatingSpawned() == 1);
+
+        // 卡住的线程恢复后补充线程退出
+        uint64_t wait_begin = ybb::GetCurrentMS();
+        while (sc.getCompensatingWorkers() && ybb::GetCurrentMS() - wait_begin < 2000)
+        {
+            usleep(1000);
+        }
+        assert(sc.getCompensatingWorkers() == 0);
+
+        // 补充线程退出后调度器照常工作
+        static std::atomic<bool> after;
+        after = false;
+        sc.schedule([]() { after = true; });
+        sc.stop();
+        assert(after);
+    }
+    printf("testWatchdog passed\n");
+    return 0;
+}
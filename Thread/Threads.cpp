@@ -7,6 +7,7 @@
 
 #include "Threads.h"
 #include "../util.h"
+#include "../Log/Log.h"
 #include <pthread.h>
 #include <mutex>
 #include <semaphore.h>
@@ -35,26 +36,55 @@ void Thread::SetName(const std::string &name)
         t_thread->m_name = name;
     }
     t_thread_name = name;
+    Logger::SetThreadName(name.c_str());
 }
 
-Thread::Thread(std::function<void()> cb, const std::string &name)
+Thread::Thread(std::function<void()> cb, const std::string &name, const ThreadAttr &attr, bool wait_start)
     : m_cb(cb), m_name(name)
 {
     if (name.empty())
     {
         m_name = "UNKNOW";
     }
-    int rt = pthread_create(&m_thread, nullptr, &Thread::run, this);
+    pthread_attr_t pattr;
+    pthread_attr_init(&pattr);
+    if (attr.stackSize)
+    {
+        pthread_attr_setstacksize(&pattr, attr.stackSize);
+    }
+    if (attr.cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(attr.cpu, &cpus);
+        pthread_attr_setaffinity_np(&pattr, sizeof(cpus), &cpus);
+    }
+    int rt = pthread_create(&m_thread, &pattr, &Thread::run, this);
+    pthread_attr_destroy(&pattr);
     if (rt)
     {
-        printf("pthread_create thread fail, rt= %d name= %s ", rt, m_name);
+        YBB_LOG_ERROR("pthread_create thread fail, rt= %d name= %s", rt, m_name.c_str());
         throw std::logic_error("pthread_create error");
     }
-    m_semaphore.wait();
+    if (wait_start)
+    {
+        waitStarted();
+    }
+}
+
+void Thread::waitStarted()
+{
+    if (!m_started)
+    {
+        m_semaphore.wait();
+        m_started = true;
+    }
 }
 
 Thread::~Thread()
 {
+    // 子线程启动时还会访问this，析构前必须确认它已经启动
+    waitStarted();
     if (m_thread)
     {
         pthread_detach(m_thread);
@@ -68,7 +98,7 @@ void Thread::join()
         int rt = pthread_join(m_thread, nullptr);
         if (rt)
         {
-            printf("pthread_join thread fail, rt= %d name= %s ", rt, m_name);
+            YBB_LOG_ERROR("pthread_join thread fail, rt= %d name= %s", rt, m_name.c_str());
             throw std::logic_error("pthread_join error");
         }
         m_thread = 0;
@@ -80,6 +110,7 @@ void *Thread::run(void *arg)
     Thread *thread = (Thread *)arg;
     t_thread = thread;
     t_thread_name = thread->m_name;
+    Logger::SetThreadName(thread->m_name.c_str());
     thread->m_id = ybb::GetThreadId();
     pthread_setname_np(pthread_self(), thread->m_name.substr(0, 15).c_str());
 
@@ -12,6 +12,17 @@
 #include "../Mutex/Mutex.h"
 
 
+/**
+ * @brief 线程属性
+ */
+struct ThreadAttr
+{
+    /// 栈大小，0表示使用系统默认值
+    size_t stackSize = 0;
+    /// 绑定的CPU编号，-1表示不绑定
+    int cpu = -1;
+};
+
 /**
  * @brief 线程类
  */
@@ -24,8 +35,12 @@ public:
      * @brief 构造函数
      * @param[in] cb 线程执行函数
      * @param[in] name 线程名称
+     * @param[in] attr 线程属性
+     * @param[in] wait_start 是否等待线程真正跑起来再返回，
+     * 批量创建线程时传false，全部创建完再逐个waitStarted()，让线程的启动并行进行
      */
-    Thread(std::function<void()> cb, const std::string &name);
+    Thread(std::function<void()> cb, const std::string &name,
+           const ThreadAttr &attr = ThreadAttr(), bool wait_start = true);
 
     /**
      * @brief 析构函数
@@ -47,6 +62,11 @@ public:
      */
     void join();
 
+    /**
+     * @brief 等待线程启动完成，之后getId()才有效
+     */
+    void waitStarted();
+
     /**
      * @brief 获取当前的线程指针
      */
@@ -80,6 +100,8 @@ private:
     std::string m_name;
     /// 信号量
     Semaphore m_semaphore;
+    /// 是否已经确认线程启动
+    bool m_started = false;
 };
 
 
@@ -0,0 +1,82 @@
+/**
+ * @file Probes.h
+ * @brief USDT静态探针
+ * @details 与systemtap的sys/sdt.h兼容的仅头文件实现，不依赖systemtap-sdt-dev：
+ * 每个探针在代码里只是一条nop，探针地址、名字和参数位置记录在.note.stapsdt段中，
+ * perf probe、bpftrace、systemtap可以直接在运行中的进程上挂载，不需要重新编译。
+ * 参数统一转换成64位整数，参数位置由编译器通过"nor"约束给出(寄存器、内存或立即数)。
+ * 没有使用探针信号量，因此参数总会被求值，探针参数应当是已经在寄存器里的便宜值。
+ * 定义YBB_NO_PROBES可以去掉所有探针。
+ *
+ * 探针列表(provider为ybb)：
+ *   coroutine__create(id, stack_size)
+ *   coroutine__resume(id, run_in_scheduler)
+ *   coroutine__yield(id, state)
+ *   coroutine__term(id)
+ *   scheduler__schedule(id, queue_depth, thread)   thread为指定的线程号，-1为任意线程
+ *   scheduler__dequeue(id, queue_depth, worker)     从run-next槽取出时queue_depth为0
+ *   scheduler__idle__enter(worker)
+ *   scheduler__idle__exit(worker)
+ *   scheduler__tickle(idle_threads)
+ * 协程id为0表示函数任务，无栈协程的id为协程帧地址
+ */
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+#include <stdint.h>
+
+#if defined(YBB_NO_PROBES) || !defined(__x86_64__) || !defined(__GNUC__)
+
+#define YBB_PROBE0(name) do { } while (0)
+#define YBB_PROBE1(name, a1) do { (void)(a1); } while (0)
+#define YBB_PROBE2(name, a1, a2) do { (void)(a1); (void)(a2); } while (0)
+#define YBB_PROBE3(name, a1, a2, a3) do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+
+#else
+
+#define _YBB_PROBE_STR(x) #x
+
+// 探针的ELF note，格式与sys/sdt.h的第3版相同
+#define _YBB_PROBE_NOTE(provider, name, args)                                        \
+    "990: nop\n"                                                                     \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                    \
+    ".balign 4\n"                                                                    \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                               \
+    "991: .asciz \"stapsdt\"\n"                                                      \
+    "992: .balign 4\n"                                                               \
+    "993: .8byte 990b\n"                                                             \
+    ".8byte _.stapsdt.base\n"                                                        \
+    ".8byte 0\n"                                                                     \
+    ".asciz \"" _YBB_PROBE_STR(provider) "\"\n"                                      \
+    ".asciz \"" _YBB_PROBE_STR(name) "\"\n"                                          \
+    ".asciz \"" args "\"\n"                                                          \
+    "994: .balign 4\n"                                                               \
+    ".popsection\n"                                                                  \
+    ".ifndef _.stapsdt.base\n"                                                       \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"          \
+    ".weak _.stapsdt.base\n"                                                         \
+    ".hidden _.stapsdt.base\n"                                                       \
+    "_.stapsdt.base: .space 1\n"                                                     \
+    ".size _.stapsdt.base, 1\n"                                                      \
+    ".popsection\n"                                                                  \
+    ".endif\n"
+
+#define YBB_PROBE0(name) \
+    __asm__ __volatile__(_YBB_PROBE_NOTE(ybb, name, ""))
+
+#define YBB_PROBE1(name, a1)                                      \
+    __asm__ __volatile__(_YBB_PROBE_NOTE(ybb, name, "-8@%[_a1]") \
+                         : : [_a1] "nor"((int64_t)(a1)))
+
+#define YBB_PROBE2(name, a1, a2)                                               \
+    __asm__ __volatile__(_YBB_PROBE_NOTE(ybb, name, "-8@%[_a1] -8@%[_a2]")    \
+                         : : [_a1] "nor"((int64_t)(a1)), [_a2] "nor"((int64_t)(a2)))
+
+#define YBB_PROBE3(name, a1, a2, a3)                                                   \
+    __asm__ __volatile__(_YBB_PROBE_NOTE(ybb, name, "-8@%[_a1] -8@%[_a2] -8@%[_a3]")  \
+                         : : [_a1] "nor"((int64_t)(a1)), [_a2] "nor"((int64_t)(a2)),    \
+                           [_a3] "nor"((int64_t)(a3)))
+
+#endif
+
+#endif
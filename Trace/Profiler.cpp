@@ -0,0 +1,252 @@
+#include "Profiler.h"
+#include "../Coroutine/Coroutine.h"
+#include "../Coroutine/StackUnwind.h"
+#include <atomic>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+namespace
+{
+    // 样本缓冲区，Start()时分配，只在没有信号处理函数运行时释放
+    Profiler::Sample *s_samples = nullptr;
+    size_t s_capacity = 0;
+    // 已经申请的样本下标，可能超过容量
+    std::atomic<size_t> s_next{0};
+    std::atomic<size_t> s_dropped{0};
+    std::atomic<bool> s_running{false};
+    // 正在执行的信号处理函数数量
+    std::atomic<int> s_inHandler{0};
+
+    void OnProfSignal(int, siginfo_t *, void *uctx)
+    {
+        int saved = errno;
+        s_inHandler.fetch_add(1);
+        if (!s_running.load())
+        {
+            s_inHandler.fetch_sub(1);
+            errno = saved;
+            return;
+        }
+        size_t idx = s_next.fetch_add(1, std::memory_order_relaxed);
+        if (idx >= s_capacity)
+        {
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
+            s_inHandler.fetch_sub(1);
+            errno = saved;
+            return;
+        }
+        Profiler::Sample &sample = s_samples[idx];
+        Coroutine *co = Coroutine::GetCurrent();
+        sample.coroutineId = co ? co->getId() : 0;
+        sample.label = co ? co->getLabel() : nullptr;
+        sample.onCoroutineStack = false;
+        sample.depth = 0;
+#if defined(__x86_64__)
+        const ucontext_t *uc = (const ucontext_t *)uctx;
+        uintptr_t pc = uc->uc_mcontext.gregs[REG_RIP];
+        uintptr_t fp = uc->uc_mcontext.gregs[REG_RBP];
+        uintptr_t sp = uc->uc_mcontext.gregs[REG_RSP];
+        uintptr_t lo = co ? (uintptr_t)co->getStack() : 0;
+        uintptr_t hi = lo + (co ? co->getStackSize() : 0);
+        if (lo && sp >= lo && sp < hi)
+        {
+            // 在协程栈上，回溯范围就是这个栈，不会读到别处
+            sample.onCoroutineStack = true;
+            sample.depth = ybb::UnwindFramePointers(pc, fp, sp, hi, sample.frames, Profiler::kMaxFrames);
+        }
+        else
+        {
+            // 线程栈的边界在信号处理函数里拿不到，只记录被打断的位置
+            sample.frames[0] = (void *)pc;
+            sample.depth = 1;
+        }
+#else
+        (void)uctx;
+#endif
+        s_inHandler.fetch_sub(1);
+        errno = saved;
+    }
+
+    /**
+     * @brief 地址对应的函数名，找不到符号时用模块名+偏移
+     */
+    std::string Symbolize(void *addr)
+    {
+        Dl_info info;
+        if (!dladdr(addr, &info))
+        {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%p", addr);
+            return buf;
+        }
+        if (info.dli_sname)
+        {
+            int status = 0;
+            char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+            free(demangled);
+            return name;
+        }
+        const char *module = info.dli_fname ? strrchr(info.dli_fname, '/') : nullptr;
+        module = module ? module + 1 : (info.dli_fname ? info.dli_fname : "?");
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%s+0x%lx", module, (uintptr_t)addr - (uintptr_t)info.dli_fbase);
+        return buf;
+    }
+
+    /**
+     * @brief folded格式用分号分隔帧，函数名里的分号替换掉
+     */
+    void AppendFrame(std::string &stack, const std::string &name)
+    {
+        stack += ';';
+        for (char c : name)
+        {
+            stack += c == ';' ? ':' : c;
+        }
+    }
+}
+
+bool Profiler::Start(int hz, size_t capacity)
+{
+    if (s_running || hz <= 0 || capacity == 0)
+    {
+        return false;
+    }
+    if (capacity != s_capacity)
+    {
+        delete[] s_samples;
+        s_samples = new Sample[capacity];
+        s_capacity = capacity;
+    }
+    s_next = 0;
+    s_dropped = 0;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = &OnProfSignal;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, nullptr))
+    {
+        return false;
+    }
+    s_running = true;
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = hz >= 1000000 ? 1 : 1000000 / hz;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr))
+    {
+        s_running = false;
+        return false;
+    }
+    return true;
+}
+
+void Profiler::Stop()
+{
+    if (!s_running)
+    {
+        return;
+    }
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    s_running = false;
+    // 已经产生还没有递送的SIGPROF默认会终止进程，改成忽略
+    signal(SIGPROF, SIG_IGN);
+    // 等其他线程上正在执行的信号处理函数写完样本
+    while (s_inHandler.load())
+    {
+        sched_yield();
+    }
+}
+
+bool Profiler::Running()
+{
+    return s_running;
+}
+
+size_t Profiler::SampleCount()
+{
+    size_t n = s_next.load();
+    return n < s_capacity ? n : s_capacity;
+}
+
+size_t Profiler::Dropped()
+{
+    return s_dropped;
+}
+
+std::vector<Profiler::Sample> Profiler::Samples()
+{
+    return std::vector<Sample>(s_samples, s_samples + SampleCount());
+}
+
+std::map<std::string, uint64_t> Profiler::Folded()
+{
+    std::map<std::string, uint64_t> folded;
+    std::map<void *, std::string> symbols;
+    size_t count = SampleCount();
+    for (size_t i = 0; i < count; i++)
+    {
+        const Sample &sample = s_samples[i];
+        std::string stack;
+        if (!sample.onCoroutineStack)
+        {
+            stack = "[thread]";
+        }
+        else
+        {
+            stack = sample.label ? sample.label : "[coroutine]";
+        }
+        // 样本里是从内到外，folded格式从外到内
+        for (size_t j = sample.depth; j > 0; j--)
+        {
+            // 除了第一帧，其他都是返回地址，减一才落在调用指令所在的函数里
+            void *addr = sample.frames[j - 1];
+            void *lookup = j - 1 == 0 ? addr : (void *)((uintptr_t)addr - 1);
+            auto it = symbols.find(lookup);
+            if (it == symbols.end())
+            {
+                it = symbols.insert(std::make_pair(lookup, Symbolize(lookup))).first;
+            }
+            AppendFrame(stack, it->second);
+        }
+        folded[stack]++;
+    }
+    return folded;
+}
+
+bool Profiler::WriteFolded(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp)
+    {
+        return false;
+    }
+    for (auto &i : Folded())
+    {
+        fprintf(fp, "%s %lu\n", i.first.c_str(), i.second);
+    }
+    return fclose(fp) == 0;
+}
+
+void Profiler::Clear()
+{
+    if (!s_running)
+    {
+        s_next = 0;
+        s_dropped = 0;
+    }
+}
@@ -0,0 +1,96 @@
+/**
+ * @file Profiler.h
+ * @brief 按协程和任务标签归类的采样CPU分析器
+ * @details 用ITIMER_PROF按进程CPU时间定时产生SIGPROF，信号处理函数在被打断的线程上
+ * 读取当前协程的id和标签(Coroutine::setLabel)，从信号上下文的rip/rbp沿帧指针回溯，
+ * 回溯范围限制在当前协程自己的栈内；不在协程栈上时(调度循环、线程主函数)只记录rip。
+ * 样本写入启动时预先分配好的缓冲区，信号处理函数里不分配内存也不加锁。
+ * 停止后可以导出folded格式(标签;外层函数;...;内层函数 次数)，直接交给flamegraph.pl。
+ * 回溯依赖帧指针，优化编译时需要-fno-omit-frame-pointer；函数名需要链接时加-rdynamic
+ */
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 采样分析器
+ */
+class Profiler
+{
+public:
+    /// 每个样本最多记录的帧数
+    static const size_t kMaxFrames = 32;
+
+    /**
+     * @brief 一个样本
+     */
+    struct Sample
+    {
+        // 被打断时正在运行的协程id，0表示线程主协程
+        uint64_t coroutineId;
+        // 协程的任务标签，可能为nullptr
+        const char *label;
+        // 是否在协程自己的栈上
+        bool onCoroutineStack;
+        // 帧数
+        uint32_t depth;
+        // 返回地址，frames[0]为被打断的位置
+        void *frames[kMaxFrames];
+    };
+
+    /**
+     * @brief 开始采样
+     * @param[in] hz 每秒CPU时间的采样次数
+     * @param[in] capacity 最多保存的样本数，满了之后的样本丢弃
+     * @return 已经在采样或者设置定时器失败时返回false
+     */
+    static bool Start(int hz = 99, size_t capacity = 1 << 14);
+
+    /**
+     * @brief 停止采样，样本保留到Clear()或者下一次Start()
+     */
+    static void Stop();
+
+    /**
+     * @brief 是否正在采样
+     */
+    static bool Running();
+
+    /**
+     * @brief 已经采集的样本数
+     */
+    static size_t SampleCount();
+
+    /**
+     * @brief 因为缓冲区满丢弃的样本数
+     */
+    static size_t Dropped();
+
+    /**
+     * @brief 复制所有样本，应在Stop()之后调用
+     */
+    static std::vector<Sample> Samples();
+
+    /**
+     * @brief 按folded格式汇总，key为"标签;外层函数;...;内层函数"，value为样本数
+     * @details 没有标签的协程归为[coroutine]，不在协程栈上的样本归为[thread]
+     */
+    static std::map<std::string, uint64_t> Folded();
+
+    /**
+     * @brief 把folded格式写到文件，每行"调用栈 次数"
+     */
+    static bool WriteFolded(const std::string &path);
+
+    /**
+     * @brief 丢弃所有样本
+     */
+    static void Clear();
+};
+
+#endif
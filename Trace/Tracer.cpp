@@ -0,0 +1,302 @@
+#include "Tracer.h"
+#include "../Mutex/Mutex.h"
+#include "../Thread/Threads.h"
+#include "../util.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+namespace
+{
+    /**
+     * @brief 一个事件
+     */
+    struct TraceRecord
+    {
+        uint64_t ns;
+        uint64_t id;
+        int32_t worker;
+        int32_t event;
+    };
+
+    /**
+     * @brief 一个线程的环形缓冲区，只有所属线程写入
+     */
+    struct TraceBuffer
+    {
+        pid_t tid = 0;
+        char name[16] = {0};
+        // 已经写入的事件总数，下一个事件写在head % kRingSize
+        std::atomic<uint64_t> head{0};
+        // 所属线程已经退出，Clear()之后可以给新线程复用
+        bool exited = false;
+        TraceRecord records[Tracer::kRingSize];
+    };
+
+    /**
+     * @brief 全局追踪状态
+     */
+    struct TraceState
+    {
+        Mutex mutex;
+        // 所有缓冲区，线程退出后保留到Clear()
+        std::vector<TraceBuffer *> buffers;
+        // 可以复用的缓冲区
+        std::vector<TraceBuffer *> freeBuffers;
+    };
+
+    TraceState &GetState()
+    {
+        // 故意不析构，进程退出过程中可能还有线程在记录
+        static TraceState *state = new TraceState;
+        return *state;
+    }
+
+    thread_local TraceBuffer *t_buffer = nullptr;
+
+    /**
+     * @brief 线程退出时标记缓冲区，事件保留到下一次Clear()
+     */
+    struct BufferGuard
+    {
+        ~BufferGuard()
+        {
+            TraceState &state = GetState();
+            Mutex::Lock lock(state.mutex);
+            t_buffer->exited = true;
+            t_buffer = nullptr;
+        }
+    };
+
+    TraceBuffer *GetBuffer()
+    {
+        if (t_buffer)
+        {
+            return t_buffer;
+        }
+        TraceState &state = GetState();
+        TraceBuffer *buffer = nullptr;
+        {
+            Mutex::Lock lock(state.mutex);
+            if (!state.freeBuffers.empty())
+            {
+                buffer = state.freeBuffers.back();
+                state.freeBuffers.pop_back();
+            }
+            else
+            {
+                buffer = new TraceBuffer;
+            }
+            buffer->tid = ybb::GetThreadId();
+            strncpy(buffer->name, Thread::GetName().c_str(), sizeof(buffer->name) - 1);
+            buffer->head = 0;
+            buffer->exited = false;
+            state.buffers.push_back(buffer);
+        }
+        static thread_local BufferGuard guard;
+        (void)guard;
+        t_buffer = buffer;
+        return buffer;
+    }
+
+    uint64_t NowNS()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+    }
+
+    /**
+     * @brief 协程id直接输出，无栈协程的地址按十六进制输出
+     */
+    void FormatId(uint64_t id, char *buf, size_t size)
+    {
+        if (id > 0xffffffffull)
+        {
+            snprintf(buf, size, "0x%lx", id);
+        }
+        else
+        {
+            snprintf(buf, size, "%lu", id);
+        }
+    }
+}
+
+void Tracer::Start()
+{
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::Stop()
+{
+    s_enabled.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::Record(Event event, uint64_t id, int worker)
+{
+    TraceBuffer *buffer = GetBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    TraceRecord &record = buffer->records[head & (kRingSize - 1)];
+    record.ns = NowNS();
+    record.id = id;
+    record.worker = worker;
+    record.event = event;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::Clear()
+{
+    TraceState &state = GetState();
+    Mutex::Lock lock(state.mutex);
+    std::vector<TraceBuffer *> live;
+    for (auto buffer : state.buffers)
+    {
+        if (buffer->exited)
+        {
+            state.freeBuffers.push_back(buffer);
+        }
+        else
+        {
+            buffer->head.store(0, std::memory_order_relaxed);
+            live.push_back(buffer);
+        }
+    }
+    state.buffers.swap(live);
+}
+
+size_t Tracer::Count()
+{
+    TraceState &state = GetState();
+    Mutex::Lock lock(state.mutex);
+    size_t count = 0;
+    for (auto buffer : state.buffers)
+    {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        count += head < kRingSize ? head : kRingSize;
+    }
+    return count;
+}
+
+bool Tracer::WriteChromeTrace(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp)
+    {
+        return false;
+    }
+    TraceState &state = GetState();
+    Mutex::Lock lock(state.mutex);
+
+    // 时间戳从最早的事件开始算
+    uint64_t base = UINT64_MAX;
+    for (auto buffer : state.buffers)
+    {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        if (head)
+        {
+            uint64_t first = head > kRingSize ? head - kRingSize : 0;
+            base = std::min(base, buffer->records[first & (kRingSize - 1)].ns);
+        }
+    }
+
+    pid_t pid = getpid();
+    bool first_event = true;
+    auto sep = [&]() {
+        fputs(first_event ? "\n" : ",\n", fp);
+        first_event = false;
+    };
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", fp);
+    for (auto buffer : state.buffers)
+    {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        if (!head)
+        {
+            continue;
+        }
+        sep();
+        fprintf(fp, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                pid, buffer->tid, buffer->name);
+        // 环形缓冲区覆盖过时，开头可能是没有配对开始事件的结束事件，跳过
+        int depth = 0;
+        for (uint64_t i = head > kRingSize ? head - kRingSize : 0; i < head; i++)
+        {
+            const TraceRecord &r = buffer->records[i & (kRingSize - 1)];
+            double ts = (r.ns - base) / 1000.0;
+            char id[32];
+            FormatId(r.id, id, sizeof(id));
+            switch (r.event)
+            {
+            case SCHEDULE:
+                if (!r.id)
+                {
+                    break;
+                }
+                // 入队到恢复之间用异步事件表示，跨线程也能连起来
+                sep();
+                fprintf(fp, "{\"ph\":\"b\",\"cat\":\"queue\",\"name\":\"queued\",\"id\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"worker\":%d}}",
+                        id, pid, buffer->tid, ts, r.worker);
+                break;
+            case RESUME:
+                if (r.id)
+                {
+                    sep();
+                    fprintf(fp, "{\"ph\":\"e\",\"cat\":\"queue\",\"name\":\"queued\",\"id\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}",
+                            id, pid, buffer->tid, ts);
+                }
+                sep();
+                // 函数任务没有id，也没有排队事件
+                fprintf(fp, "{\"ph\":\"B\",\"cat\":\"run\",\"name\":\"run %s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"id\":\"%s\",\"worker\":%d}}",
+                        r.id ? id : "func", pid, buffer->tid, ts, id, r.worker);
+                ++depth;
+                break;
+            case PARK:
+                sep();
+                fprintf(fp, "{\"ph\":\"B\",\"cat\":\"idle\",\"name\":\"idle\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"worker\":%d}}",
+                        pid, buffer->tid, ts, r.worker);
+                ++depth;
+                break;
+            case YIELD:
+            case WAKE:
+                if (depth == 0)
+                {
+                    break;
+                }
+                sep();
+                fprintf(fp, "{\"ph\":\"E\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}", pid, buffer->tid, ts);
+                --depth;
+                break;
+            case STEAL:
+                sep();
+                fprintf(fp, "{\"ph\":\"i\",\"s\":\"t\",\"cat\":\"steal\",\"name\":\"steal\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"id\":\"%s\",\"worker\":%d}}",
+                        pid, buffer->tid, ts, id, r.worker);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    fputs("\n]}\n", fp);
+    return fclose(fp) == 0;
+}
+
+const char *Tracer::ToString(Event event)
+{
+    switch (event)
+    {
+    case SCHEDULE:
+        return "SCHEDULE";
+    case RESUME:
+        return "RESUME";
+    case YIELD:
+        return "YIELD";
+    case STEAL:
+        return "STEAL";
+    case PARK:
+        return "PARK";
+    case WAKE:
+        return "WAKE";
+    default:
+        return "UNKNOW";
+    }
+}
@@ -0,0 +1,104 @@
+/**
+ * @file Tracer.h
+ * @brief 调度时间线追踪
+ * @details 记录调度器的入队、恢复、让出、偷取、空闲和唤醒事件，
+ * 每个线程写自己的环形缓冲区(满了覆盖最旧的事件)，写入只有一次取时间和几次普通存储；
+ * 默认关闭，关闭时每个埋点只多一次原子变量读取。
+ * 停止后导出为Chrome trace-event JSON，用chrome://tracing或ui.perfetto.dev打开，
+ * 可以在时间线上看到每个协程在任务队列里等了多久、在哪个线程上跑了多久
+ */
+#ifndef __TRACER_H__
+#define __TRACER_H__
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief 调度事件追踪器
+ */
+class Tracer
+{
+public:
+    /**
+     * @brief 事件类型
+     */
+    enum Event
+    {
+        // 任务进入任务队列
+        SCHEDULE = 0,
+        // 开始执行任务
+        RESUME = 1,
+        // 任务让出或者结束，回到调度循环
+        YIELD = 2,
+        // 从其他工作线程偷取任务
+        STEAL = 3,
+        // 工作线程进入空闲
+        PARK = 4,
+        // 工作线程离开空闲
+        WAKE = 5
+    };
+
+    /// 每个线程环形缓冲区的事件数，必须是2的幂
+    static const size_t kRingSize = 1 << 14;
+
+    /**
+     * @brief 开始记录
+     */
+    static void Start();
+
+    /**
+     * @brief 停止记录，已经记录的事件保留到Clear()
+     */
+    static void Stop();
+
+    /**
+     * @brief 是否正在记录
+     */
+    static bool Enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 记录一个事件，一般通过YBB_TRACE宏调用
+     * @param[in] event 事件类型
+     * @param[in] id 协程id或者无栈协程地址，0表示没有
+     * @param[in] worker 工作线程序号，-1表示不是工作线程
+     */
+    static void Record(Event event, uint64_t id, int worker = -1);
+
+    /**
+     * @brief 丢弃已经记录的事件
+     */
+    static void Clear();
+
+    /**
+     * @brief 已经记录的事件数(不超过缓冲区容量)
+     */
+    static size_t Count();
+
+    /**
+     * @brief 导出为Chrome trace-event JSON
+     * @details 应该在Stop()之后调用，否则正在写入的线程可能覆盖正在导出的事件
+     * @param[in] path 输出文件路径
+     * @return 是否成功
+     */
+    static bool WriteChromeTrace(const std::string &path);
+
+    /**
+     * @brief 事件名
+     */
+    static const char *ToString(Event event);
+
+private:
+    static inline std::atomic<bool> s_enabled{false};
+};
+
+#define YBB_TRACE(event, id, worker)                   \
+    do                                                 \
+    {                                                  \
+        if (Tracer::Enabled())                         \
+        {                                              \
+            Tracer::Record(Tracer::event, id, worker); \
+        }                                              \
+    } while (0)
+
+#endif
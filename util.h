@@ -7,6 +7,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/syscall.h>
+#include <time.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <vector>
@@ -22,6 +23,34 @@ static pid_t GetThreadId() {
 static uint64_t GetCoroutineId() {
     return Coroutine::GetCoroutineId();
 }
+
+/**
+ * @brief 获取单调时钟的当前时间(毫秒)
+ */
+static uint64_t GetCurrentMS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ul + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 获取单调时钟的当前时间(微秒)
+ */
+static uint64_t GetCurrentUS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief 获取粗粒度单调时钟的当前时间(微秒)
+ * @details 精度为一个时钟节拍(通常几毫秒)，开销比GetCurrentUS小，用于热路径上的统计
+ */
+static uint64_t GetCoarseUS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
 }
 
 #endif